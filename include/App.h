@@ -1,12 +1,15 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
-class ImageProcessor;
+class ExportQueue;
+class ProcessingWorker;
 class Renderer;
+class ViewCache;
 
 class App {
 public:
@@ -21,15 +24,21 @@ public:
     // Image loading
     void loadImage(const std::string& filepath);
 
+    // Keep results of loaded images in an on-disk cache (see ResultCache)
+    void setResultCache(const std::string& directory, uint64_t maxBytes);
+
 private:
     GLFWwindow* window;
     int windowWidth, windowHeight;
     bool running;
 
-    std::unique_ptr<ImageProcessor> imageProcessor;
+    std::unique_ptr<ProcessingWorker> worker;
     std::unique_ptr<Renderer> renderer;
+    std::unique_ptr<ViewCache> viewCache;
+    std::unique_ptr<ExportQueue> exportQueue;
 
     void initOpenGL();
     void initImGui();
+    void setDisplayMode(int mode);
     void cleanup();
 };
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "ImageProcessor.h"
+#include <cstdint>
+#include <string>
+
+// Headless directory-to-directory processing. Decode, process and encode run
+// as separate thread groups connected by bounded queues, so I/O overlaps with
+// the pipeline and memory stays bounded no matter how many files there are.
+class BatchProcessor {
+public:
+    struct Options {
+        std::string inputDir;
+        std::string outputDir;
+        std::string extension = "png";  // Output format
+        int displayMode = 5;            // Same numbering as ImageProcessor::composeView
+        int threads = 0;                // Process threads (0 = one per core)
+        std::string cacheDir;           // ResultCache directory (empty = no cache)
+        uint64_t cacheSize = 2048ull << 20;     // Cache size limit in bytes
+        ImageProcessor::Params params;
+    };
+
+    explicit BatchProcessor(const Options& options);
+
+    // Process every image in inputDir. Returns the number of failed files.
+    int run();
+
+private:
+    Options options;
+};
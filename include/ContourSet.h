@@ -0,0 +1,65 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <vector>
+
+// Contours stored back to back in one point buffer, with an offset table and
+// per-contour features computed once when a contour is added.
+//
+// Replaces std::vector<std::vector<cv::Point>>: clearing and refilling or
+// copying a set reuses a few flat allocations instead of one per contour,
+// and stages that walk contours read contiguous memory. draw() takes the
+// place of cv::drawContours by handing the buffer straight to cv::polylines.
+class ContourSet {
+public:
+    struct Features {
+        double area = 0.0;
+        double length = 0.0;        // Open arc length
+        cv::Rect bbox;
+        cv::Point2f centroid;       // Of the enclosed area (point mean if degenerate)
+    };
+
+    // Read-only view of one contour's points, valid until the set changes
+    class View {
+    public:
+        View(const cv::Point* points, size_t count) : pts(points), n(count) {}
+        size_t size() const { return n; }
+        bool empty() const { return n == 0; }
+        const cv::Point& operator[](size_t i) const { return pts[i]; }
+        const cv::Point* begin() const { return pts; }
+        const cv::Point* end() const { return pts + n; }
+        const cv::Point* data() const { return pts; }
+        // Nx1 CV_32SC2 header over the points for OpenCV calls (no copy)
+        cv::Mat mat() const { return cv::Mat(static_cast<int>(n), 1, CV_32SC2, const_cast<cv::Point*>(pts)); }
+
+    private:
+        const cv::Point* pts;
+        size_t n;
+    };
+
+    void clear();
+    void reserve(size_t contours, size_t points);
+
+    // Append a copy of the contour and compute its features
+    void add(const std::vector<cv::Point>& contour);
+    // Append a copy of a contour whose features are already known
+    void add(View contour, const Features& features);
+
+    static Features measure(const std::vector<cv::Point>& contour);
+
+    size_t size() const { return info.size(); }
+    bool empty() const { return info.empty(); }
+    View operator[](size_t i) const { return View(points.data() + offsets[i], offsets[i + 1] - offsets[i]); }
+    const Features& features(size_t i) const { return info[i]; }
+
+    // Outline contour `index` (-1 = all) like cv::drawContours with a
+    // positive thickness; offset shifts every point
+    void draw(cv::Mat& image, int index, const cv::Scalar& color, int thickness = 1,
+              int lineType = cv::LINE_8, cv::Point offset = cv::Point()) const;
+
+private:
+    std::vector<cv::Point> points;
+    std::vector<size_t> offsets{0};     // Contour i is points[offsets[i], offsets[i + 1])
+    std::vector<Features> info;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+// Counter-based random numbers: every value is a pure function of a key and
+// a counter, so a stream can be recreated anywhere (per pixel, per contour,
+// on any thread) and always yields the same sequence for the same seed.
+// Built on the SplitMix64 output function, which is cheap and passes
+// BigCrush when fed consecutive counters.
+class CounterRng {
+public:
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Key a stream by the user seed, which loop is drawing (stream) and the
+    // item within that loop (index), e.g. a pixel or contour id
+    CounterRng(uint64_t seed, uint64_t stream, uint64_t index)
+        : key(mix(mix(seed * kGolden + stream) + index * kGolden)) {}
+
+    uint64_t next() { return mix(key + kGolden * ++counter); }
+
+    // Uniform in [0, 1)
+    float uniform() { return static_cast<float>(next() >> 40) * (1.0f / 16777216.0f); }
+
+    // Uniform integer in [lo, hi]
+    int uniformInt(int lo, int hi) {
+        const uint64_t span = static_cast<uint64_t>(hi - lo) + 1;
+        return lo + static_cast<int>(((next() >> 32) * span) >> 32);
+    }
+
+private:
+    static constexpr uint64_t kGolden = 0x9E3779B97F4A7C15ull;
+    uint64_t key;
+    uint64_t counter = 0;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "BoundedQueue.h"
+#include "ImageProcessor.h"
+#include <opencv2/opencv.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Encodes and writes images on background threads, so saving a large PNG
+// never stalls the UI and several files (e.g. one per display mode) are
+// encoded at once.
+//
+// push() only takes a reference to the caller's pixels; the RGB -> BGR
+// conversion imwrite wants happens on the worker. The caller must therefore
+// never write to that buffer again: results published by ProcessingWorker
+// and the views ViewCache builds from them always get fresh allocations.
+class ExportQueue {
+public:
+    explicit ExportQueue(int threads);
+    ~ExportQueue();     // Finishes every queued export
+
+    ExportQueue(const ExportQueue&) = delete;
+    ExportQueue& operator=(const ExportQueue&) = delete;
+
+    // Queue an RGB (or grayscale) image for writing to path. Never waits;
+    // returns false if the queue is full.
+    bool push(const std::string& path, const cv::Mat& image, const EncodeOptions& options);
+
+    // Exports since the queue was last idle. Counts start over with the
+    // first push after everything queued has finished.
+    struct Progress {
+        int done = 0;
+        int total = 0;
+        int failed = 0;
+    };
+    Progress progress() const;
+
+private:
+    struct Job {
+        std::string path;
+        cv::Mat image;      // RGB or grayscale, shared with the caller
+        EncodeOptions options;
+    };
+
+    BoundedQueue<Job> jobs;
+    std::vector<std::thread> workers;
+
+    mutable std::mutex progressMutex;
+    Progress current;
+
+    void run();
+};
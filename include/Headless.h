@@ -0,0 +1,13 @@
+#pragma once
+
+// Command-line modes that run ImageProcessor without creating a window,
+// e.g. `NeonBuzz --batch in_dir out_dir --mode neon --params preset.json`
+// `NeonBuzz --video in.mp4 out.mp4 --mode brush` or
+// `NeonBuzz --tiled scan.tif scan_neon.png` for full-resolution output.
+// Nothing here touches GLFW, GLEW, OpenGL or ImGui.
+
+// True if argv[1] selects a headless mode
+bool isHeadlessCommand(const char* arg);
+
+// Parse the command line and run the selected mode; returns the exit code
+int runHeadless(int argc, char* argv[]);
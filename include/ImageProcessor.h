@@ -1,139 +1,424 @@
 #pragma once
 
+#include "ContourSet.h"
+#include "IncrementalCanny.h"
+#include "StrokeRasterizer.h"
 #include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+// Output of one processImage() run. Worker threads copy this into their own
+// buffers so the UI never reads Mats the pipeline is writing into.
+struct ProcessingResult {
+    cv::Mat originalImage;
+    cv::Mat edgeImage;
+    cv::Mat brushStrokeImage;
+    cv::Mat neonImage;
+    ContourSet contours;
+    uint64_t generation = 0;    // Bumped every time any stage is recomputed
+    unsigned stages = 0;        // ImageProcessor::Stage bits whose output is current
+    float scale = 1.0f;         // Size relative to the loaded image (< 1 for previews)
+};
+
+// Encoder settings for writing images; each format reads its own. The
+// defaults match what OpenCV writes when given no parameters, including
+// lossless WebP.
+struct EncodeOptions {
+    int pngCompression = 1;     // 0 (none, fastest) - 9 (smallest)
+    int jpegQuality = 95;       // 0 - 100
+    int webpQuality = 100;      // 1 - 100; only read when webpLossless is off
+    bool webpLossless = true;   // Sent to OpenCV as quality 101
+};
+
 class ImageProcessor {
 public:
+    // Pipeline stages, used as bits for dirty tracking.
+    // Dependencies: EDGES -> CONTOURS -> {BRUSH, NEON -> NEON_COMPOSITE}
+    enum Stage : unsigned {
+        STAGE_EDGES          = 1u << 0,
+        STAGE_CONTOURS       = 1u << 1,
+        STAGE_BRUSH          = 1u << 2,
+        STAGE_NEON           = 1u << 3,     // Neon layers and their glow
+        STAGE_NEON_COMPOSITE = 1u << 4,     // Colorize and blend them into neonImage
+        STAGE_ALL            = STAGE_EDGES | STAGE_CONTOURS | STAGE_BRUSH | STAGE_NEON | STAGE_NEON_COMPOSITE
+    };
+
+    // How createBrushStrokes() rasterizes strokes
+    enum BrushBackend : int {
+        BRUSH_OPENCV = 0,       // One cv::line(LINE_AA) per stroke
+        BRUSH_STAMP_ATLAS = 1   // Cached stamps blitted with SIMD max (StrokeRasterizer)
+    };
+
+    // How createNeonEffect() blurs the glow (see NeonGlow)
+    enum GlowBackend : int {
+        GLOW_GAUSSIAN = 0,      // Full-resolution GaussianBlur per pass
+        GLOW_PYRAMID = 1        // Blur at reduced resolution on a pyramid, like bloom
+    };
+
+    // How "Group Nearby" clusters contour centroids in per-contour neon mode
+    enum GroupingBackend : int {
+        GROUPING_KMEANS = 0,    // cv::kmeans, then split off members far from their center
+        GROUPING_GRID = 1       // Link centroids within the near distance (grid hash + union-find)
+    };
+
+    // Snapshot of every processing parameter
+    struct Params {
+        double cannyThreshold1 = 50.0;
+        double cannyThreshold2 = 150.0;
+        double contourMinArea = 100.0;
+        int brushSize = 4;
+        int brushDensity = 8;
+        int brushBackend = BRUSH_OPENCV;
+        int seed = 0;               // Brush stroke jitter; same seed = same image
+        int edgeDensityKernel = 21; // Box filter size of the brush stage's edge-density map
+
+        // Noise reduction parameters
+        int blurStrength = 5;              // Gaussian blur kernel size (must be odd)
+        bool useBilateralFilter = false;   // Use bilateral filter instead of Gaussian
+        int bilateralD = 9;                // Bilateral filter diameter
+        double bilateralSigmaColor = 75.0; // Color sigma for bilateral
+        double bilateralSigmaSpace = 75.0; // Space sigma for bilateral
+        int morphologySize = 0;            // Morphological operation kernel size (0 = disabled)
+        double minContourLength = 10.0;    // Minimum contour arc length
+        int edgeDilation = 0;              // Dilate edges to connect fragments (0 = disabled)
+        int edgeSmoothing = 0;             // Gaussian blur on edge image (0 = disabled)
+        double contourSmoothing = 0.0;     // Contour approximation epsilon (0 = disabled)
+
+        // Neon effect parameters
+        cv::Scalar neonCenterColor = cv::Scalar(255, 0, 255);   // Magenta (BGR)
+        cv::Scalar neonOtherColor = cv::Scalar(255, 255, 0);    // Cyan (BGR)
+        cv::Scalar neonEdgeColor = cv::Scalar(0, 0, 255);       // Red (BGR)
+        int neonGlowStrength = 3;   // Number of glow layers
+        int neonGlowSize = 15;      // Blur size for glow
+        int neonGlowBackend = GLOW_GAUSSIAN;
+        int neonMaxObjects = 8;      // Color only the largest N objects
+        float neonMinObjectAreaRatio = 0.01f; // Minimum object area as fraction of image (e.g. 0.01 = 1%)
+        int neonJoinSize = 15;       // Kernel size used to connect edges into objects (odd recommended)
+        bool neonPerContour = true;  // If true, every contour gets a unique color (ignores object grouping)
+        bool neonKMeansEnabled = false; // If true, k-means clusters contour centroids into groups
+        int neonKMeansK = 24;           // Initial K for k-means (final groups may be larger)
+        float neonKMeansNearDistancePx = 25.0f; // Only keep k-means grouping when members are within this distance to their center
+        int neonGroupingBackend = GROUPING_KMEANS;
+    };
+
     ImageProcessor();
     ~ImageProcessor();
 
     // Load image from file
     bool loadImage(const std::string& filepath);
-    
+
+    // Decode a file into an RGB image capped to 1024px (thread-safe)
+    static cv::Mat decodeImage(const std::string& filepath);
+
+    // Convert a decoded BGR frame to RGB and apply the same size cap.
+    // sourceSize is the size the image is stored at when it was decoded at
+    // reduced resolution, so the result is as large as from a full decode.
+    static cv::Mat prepareImage(const cv::Mat& bgrImage, cv::Size sourceSize = cv::Size());
+
+    // Use an already decoded RGB image as the new input
+    void setImage(const cv::Mat& image);
+
+    // Compute the brush stage's image gradients on a thread of their own,
+    // overlapping the edge and contour stages. Off by default: the headless
+    // pipelines already run one image per core.
+    void setAsyncGradients(bool enabled) { asyncGradients = enabled; }
+
+    // Use a result computed earlier with the current parameters (e.g. by
+    // ResultCache) as the new input and output: its `stages` are taken as
+    // up to date, the rest are dirty. Not for temporal or tiled processing.
+    void setResult(ProcessingResult cached);
+
     // Save current view to file
     bool saveImage(const std::string& filepath, int displayMode) const;
+    static bool saveImage(const ProcessingResult& result, const std::string& filepath, int displayMode);
+
+    // Build the RGB image shown by a display mode
+    // 0: Original, 1: Edges, 2: Contours, 3: Brush Strokes, 4: Combined, 5: Neon
+    static cv::Mat composeView(const ProcessingResult& result, int displayMode);
+
+    // Stages whose output a display mode reads, for processStages()
+    static unsigned viewStages(int displayMode);
+
+    // Write an RGB (or grayscale) image, converting to OpenCV's BGR order
+    static bool writeImage(const std::string& filepath, const cv::Mat& image,
+                           const EncodeOptions& options = EncodeOptions());
+
+    // cv::imwrite parameters for the options
+    static std::vector<int> encoderParams(const EncodeOptions& options);
+
+    // Read/write a parameter preset (JSON or YAML, picked from the extension).
+    // Missing keys keep their current value; colors are stored as [r, g, b].
+    static bool loadParams(const std::string& filepath, Params& params);
+    static bool saveParams(const std::string& filepath, const Params& params);
+
+    // Every parameter as one canonical string ("key=value;" in a fixed order,
+    // full precision), e.g. for keying cached results
+    static std::string serializeParams(const Params& params);
+
+    // Process: recompute every dirty stage (and nothing upstream of it).
+    // If cancel is set, it is checked between stages; returns false when the
+    // run stopped early, leaving the remaining stages dirty.
+    bool processImage(const std::atomic<bool>* cancel = nullptr);
 
-    // Process: detect edges and contours
-    void processImage();
+    // Same, but only for the given stages and the stages they depend on
+    bool processStages(unsigned stages, const std::atomic<bool>* cancel = nullptr);
 
-    // Get results
-    const cv::Mat& getOriginalImage() const { return originalImage; }
+    // Mark a stage and everything downstream of it for recomputation
+    void invalidate(Stage stage);
+    unsigned getDirtyStages() const { return dirtyStages; }
+
+    // Get results. getResult() is as of the last run, which may have left
+    // stages it was not asked for dirty; the per-output getters bring their
+    // stage up to date first.
+    const ProcessingResult& getResult() const { return result; }
+    const cv::Mat& getOriginalImage() const { return result.originalImage; }
     const cv::Mat& getProcessedImage() const { return processedImage; }
-    const cv::Mat& getEdgeImage() const { return edgeImage; }
-    const cv::Mat& getBrushStrokeImage() const { return brushStrokeImage; }
-    const cv::Mat& getNeonImage() const { return neonImage; }
-    const std::vector<std::vector<cv::Point>>& getContours() const { return contours; }
+    const cv::Mat& getEdgeImage() { processStages(STAGE_EDGES); return result.edgeImage; }
+    const cv::Mat& getBrushStrokeImage() { processStages(STAGE_BRUSH); return result.brushStrokeImage; }
+    const cv::Mat& getNeonImage() { processStages(STAGE_NEON_COMPOSITE); return result.neonImage; }
+    const ContourSet& getContours() { processStages(STAGE_CONTOURS); return result.contours; }
+
+    // Temporal coherence for video: consecutive setImage() calls are treated
+    // as frames of one clip. K-means starts from the previous frame's centers,
+    // contours matched across frames keep their stroke jitter and neon color,
+    // and brush strokes are only redrawn in blocks whose edges changed.
+    void setTemporalCoherence(bool enabled);
+    bool getTemporalCoherence() const { return temporalCoherence; }
+    // Fraction of a block's pixels whose edge state must flip before the block
+    // is redrawn (default 0.02)
+    void setTemporalEdgeThreshold(float val) { temporalEdgeThreshold = val; }
+    float getTemporalEdgeThreshold() const { return temporalEdgeThreshold; }
+    // Forget the previous frame, e.g. at a scene cut or when seeking
+    void resetTemporalState();
+
+    // Whole-image information for a processor that only sees one tile of a
+    // larger image (see TiledProcessor), so results line up across tiles
+    struct TileContext {
+        cv::Mat cannyEdges;         // CV_8U, tile-sized: Canny output with hysteresis run over
+                                    // the whole image (empty = run it on the tile)
+        cv::Mat contourLabels;      // CV_32S, tile-sized: edge pixel -> global contour id (0 = none)
+        // Per-contour neon grouping done once for the whole image: global
+        // contour id -> color id (null = group the tile's own contours)
+        std::shared_ptr<const std::unordered_map<int, int>> contourColors;
+        double densityMin = 0.0;    // Brush edge-density range of the whole image
+        double densityMax = -1.0;   // (max < min = use this tile's own range)
+        cv::Point origin;           // Tile position in the whole image
+        int fullWidth = 0;          // Whole-image width (0 = not tiled)
+    };
+    void setTileContext(const TileContext& context);
+
+    // "Group Nearby" for per-contour neon over a whole image: the color id of
+    // each contour, given its centroid and stable id, grouped with k-means or
+    // the grid as params select. TiledProcessor runs it once for all tiles.
+    static std::vector<int> groupContourColors(const std::vector<cv::Point2f>& centroids,
+                                               const std::vector<int>& ids, const Params& params);
+
+    // Canny candidates of the current image before hysteresis (see
+    // IncrementalCanny::classify), for running hysteresis across tiles
+    void classifyEdgePixels(cv::Mat& out);
 
     // Image info
-    int getWidth() const { return originalImage.cols; }
-    int getHeight() const { return originalImage.rows; }
-    bool hasImage() const { return !originalImage.empty(); }
+    int getWidth() const { return result.originalImage.cols; }
+    int getHeight() const { return result.originalImage.rows; }
+    bool hasImage() const { return !result.originalImage.empty(); }
+
+    // Apply a whole parameter snapshot; only changed fields invalidate stages
+    void setParams(const Params& p);
+
+    // Convert parameters measured in pixels (kernel sizes, areas, lengths,
+    // distances) for an image `scale` times the size, so a downscaled proxy
+    // looks like the full-resolution result
+    static Params scaleParams(const Params& p, double scale);
+    const Params& getParams() const { return params; }
 
     // Processing parameters
-    void setCannyThreshold1(double val) { cannyThreshold1 = val; }
-    void setCannyThreshold2(double val) { cannyThreshold2 = val; }
-    void setContourMinArea(double val) { contourMinArea = val; }
-    void setBrushSize(int val) { brushSize = val; }
-    void setBrushDensity(int val) { brushDensity = val; }
-    void setBlurStrength(int val) { blurStrength = val; }
-    void setBilateralFilter(bool val) { useBilateralFilter = val; }
-    void setBilateralD(int val) { bilateralD = val; }
-    void setBilateralSigmaColor(double val) { bilateralSigmaColor = val; }
-    void setBilateralSigmaSpace(double val) { bilateralSigmaSpace = val; }
-    void setMorphologySize(int val) { morphologySize = val; }
-    void setMinContourLength(double val) { minContourLength = val; }
-    void setEdgeDilation(int val) { edgeDilation = val; }
-    void setEdgeSmoothing(int val) { edgeSmoothing = val; }
-    void setContourSmoothing(double val) { contourSmoothing = val; }
-    
+    // Each setter only invalidates the stages downstream of the parameter, so
+    // processImage() recomputes the minimum suffix of the pipeline.
+    void setCannyThreshold1(double val) { setParam(params.cannyThreshold1, val, STAGE_EDGES); }
+    void setCannyThreshold2(double val) { setParam(params.cannyThreshold2, val, STAGE_EDGES); }
+    void setContourMinArea(double val) { setParam(params.contourMinArea, val, STAGE_CONTOURS); }
+    void setBrushSize(int val) { setParam(params.brushSize, val, STAGE_BRUSH); }
+    void setBrushDensity(int val) { setParam(params.brushDensity, val, STAGE_BRUSH); }
+    void setBrushBackend(int val) { setParam(params.brushBackend, val, STAGE_BRUSH); }
+    void setSeed(int val) { setParam(params.seed, val, STAGE_BRUSH); }
+    void setEdgeDensityKernel(int val) { setParam(params.edgeDensityKernel, val, STAGE_BRUSH); }
+    void setBlurStrength(int val) { setParam(params.blurStrength, val, STAGE_EDGES); }
+    void setBilateralFilter(bool val) { setParam(params.useBilateralFilter, val, STAGE_EDGES); }
+    void setBilateralD(int val) { setParam(params.bilateralD, val, STAGE_EDGES); }
+    void setBilateralSigmaColor(double val) { setParam(params.bilateralSigmaColor, val, STAGE_EDGES); }
+    void setBilateralSigmaSpace(double val) { setParam(params.bilateralSigmaSpace, val, STAGE_EDGES); }
+    void setMorphologySize(int val) { setParam(params.morphologySize, val, STAGE_EDGES); }
+    void setMinContourLength(double val) { setParam(params.minContourLength, val, STAGE_CONTOURS); }
+    void setEdgeDilation(int val) { setParam(params.edgeDilation, val, STAGE_EDGES); }
+    void setEdgeSmoothing(int val) { setParam(params.edgeSmoothing, val, STAGE_EDGES); }
+    void setContourSmoothing(double val) { setParam(params.contourSmoothing, val, STAGE_CONTOURS); }
+
     // Neon effect parameters
-    void setNeonCenterColor(float r, float g, float b) { neonCenterColor = cv::Scalar(b*255, g*255, r*255); }
-    void setNeonOtherColor(float r, float g, float b) { neonOtherColor = cv::Scalar(b*255, g*255, r*255); }
-    void setNeonEdgeColor(float r, float g, float b) { neonEdgeColor = cv::Scalar(b*255, g*255, r*255); }
-    void setNeonGlowStrength(int val) { neonGlowStrength = val; }
-    void setNeonGlowSize(int val) { neonGlowSize = val; }
-    void setNeonMaxObjects(int val) { neonMaxObjects = val; }
-    void setNeonMinObjectAreaRatio(float val) { neonMinObjectAreaRatio = val; }
-    void setNeonJoinSize(int val) { neonJoinSize = val; }
-    void setNeonPerContour(bool val) { neonPerContour = val; }
-    void setNeonKMeansEnabled(bool val) { neonKMeansEnabled = val; }
-    void setNeonKMeansK(int val) { neonKMeansK = val; }
-    void setNeonKMeansNearDistancePx(float val) { neonKMeansNearDistancePx = val; }
-    
-    cv::Scalar getNeonCenterColor() const { return neonCenterColor; }
-    cv::Scalar getNeonOtherColor() const { return neonOtherColor; }
-    cv::Scalar getNeonEdgeColor() const { return neonEdgeColor; }
-    int getNeonGlowStrength() const { return neonGlowStrength; }
-    int getNeonGlowSize() const { return neonGlowSize; }
-    int getNeonMaxObjects() const { return neonMaxObjects; }
-    float getNeonMinObjectAreaRatio() const { return neonMinObjectAreaRatio; }
-    int getNeonJoinSize() const { return neonJoinSize; }
-    bool getNeonPerContour() const { return neonPerContour; }
-    bool getNeonKMeansEnabled() const { return neonKMeansEnabled; }
-    int getNeonKMeansK() const { return neonKMeansK; }
-    float getNeonKMeansNearDistancePx() const { return neonKMeansNearDistancePx; }
-
-    double getCannyThreshold1() const { return cannyThreshold1; }
-    double getCannyThreshold2() const { return cannyThreshold2; }
-    double getContourMinArea() const { return contourMinArea; }
-    int getBrushSize() const { return brushSize; }
-    int getBrushDensity() const { return brushDensity; }
-    int getBlurStrength() const { return blurStrength; }
-    bool getBilateralFilter() const { return useBilateralFilter; }
-    int getBilateralD() const { return bilateralD; }
-    double getBilateralSigmaColor() const { return bilateralSigmaColor; }
-    double getBilateralSigmaSpace() const { return bilateralSigmaSpace; }
-    int getMorphologySize() const { return morphologySize; }
-    double getMinContourLength() const { return minContourLength; }
-    int getEdgeDilation() const { return edgeDilation; }
-    int getEdgeSmoothing() const { return edgeSmoothing; }
-    double getContourSmoothing() const { return contourSmoothing; }
+    void setNeonCenterColor(float r, float g, float b) { setParam(params.neonCenterColor, cv::Scalar(b*255, g*255, r*255), STAGE_NEON); }
+    void setNeonOtherColor(float r, float g, float b) { setParam(params.neonOtherColor, cv::Scalar(b*255, g*255, r*255), STAGE_NEON); }
+    void setNeonEdgeColor(float r, float g, float b) { setParam(params.neonEdgeColor, cv::Scalar(b*255, g*255, r*255), STAGE_NEON_COMPOSITE); }
+    void setNeonGlowStrength(int val) { setParam(params.neonGlowStrength, val, STAGE_NEON); }
+    void setNeonGlowSize(int val) { setParam(params.neonGlowSize, val, STAGE_NEON); }
+    void setNeonGlowBackend(int val) { setParam(params.neonGlowBackend, val, STAGE_NEON); }
+    void setNeonMaxObjects(int val) { setParam(params.neonMaxObjects, val, STAGE_NEON); }
+    void setNeonMinObjectAreaRatio(float val) { setParam(params.neonMinObjectAreaRatio, val, STAGE_NEON); }
+    void setNeonJoinSize(int val) { setParam(params.neonJoinSize, val, STAGE_NEON); }
+    void setNeonPerContour(bool val) { setParam(params.neonPerContour, val, STAGE_NEON); }
+    void setNeonKMeansEnabled(bool val) { setParam(params.neonKMeansEnabled, val, STAGE_NEON); }
+    void setNeonKMeansK(int val) { setParam(params.neonKMeansK, val, STAGE_NEON); }
+    void setNeonKMeansNearDistancePx(float val) { setParam(params.neonKMeansNearDistancePx, val, STAGE_NEON); }
+    void setNeonGroupingBackend(int val) { setParam(params.neonGroupingBackend, val, STAGE_NEON); }
+
+    cv::Scalar getNeonCenterColor() const { return params.neonCenterColor; }
+    cv::Scalar getNeonOtherColor() const { return params.neonOtherColor; }
+    cv::Scalar getNeonEdgeColor() const { return params.neonEdgeColor; }
+    int getNeonGlowStrength() const { return params.neonGlowStrength; }
+    int getNeonGlowSize() const { return params.neonGlowSize; }
+    int getNeonGlowBackend() const { return params.neonGlowBackend; }
+    int getNeonMaxObjects() const { return params.neonMaxObjects; }
+    float getNeonMinObjectAreaRatio() const { return params.neonMinObjectAreaRatio; }
+    int getNeonJoinSize() const { return params.neonJoinSize; }
+    bool getNeonPerContour() const { return params.neonPerContour; }
+    bool getNeonKMeansEnabled() const { return params.neonKMeansEnabled; }
+    int getNeonKMeansK() const { return params.neonKMeansK; }
+    float getNeonKMeansNearDistancePx() const { return params.neonKMeansNearDistancePx; }
+    int getNeonGroupingBackend() const { return params.neonGroupingBackend; }
+
+    double getCannyThreshold1() const { return params.cannyThreshold1; }
+    double getCannyThreshold2() const { return params.cannyThreshold2; }
+    double getContourMinArea() const { return params.contourMinArea; }
+    int getBrushSize() const { return params.brushSize; }
+    int getBrushDensity() const { return params.brushDensity; }
+    int getBrushBackend() const { return params.brushBackend; }
+    int getSeed() const { return params.seed; }
+    int getEdgeDensityKernel() const { return params.edgeDensityKernel; }
+    int getBlurStrength() const { return params.blurStrength; }
+    bool getBilateralFilter() const { return params.useBilateralFilter; }
+    int getBilateralD() const { return params.bilateralD; }
+    double getBilateralSigmaColor() const { return params.bilateralSigmaColor; }
+    double getBilateralSigmaSpace() const { return params.bilateralSigmaSpace; }
+    int getMorphologySize() const { return params.morphologySize; }
+    double getMinContourLength() const { return params.minContourLength; }
+    int getEdgeDilation() const { return params.edgeDilation; }
+    int getEdgeSmoothing() const { return params.edgeSmoothing; }
+    double getContourSmoothing() const { return params.contourSmoothing; }
 
 private:
-    cv::Mat originalImage;
+    ProcessingResult result;
     cv::Mat processedImage;
-    cv::Mat edgeImage;
-    cv::Mat brushStrokeImage;
-    cv::Mat neonImage;
-    std::vector<std::vector<cv::Point>> contours;
 
-    // Processing parameters
-    double cannyThreshold1 = 50.0;
-    double cannyThreshold2 = 150.0;
-    double contourMinArea = 100.0;
-    int brushSize = 4;
-    int brushDensity = 8;
-    
-    // Noise reduction parameters
-    int blurStrength = 5;              // Gaussian blur kernel size (must be odd)
-    bool useBilateralFilter = false;   // Use bilateral filter instead of Gaussian
-    int bilateralD = 9;                // Bilateral filter diameter
-    double bilateralSigmaColor = 75.0; // Color sigma for bilateral
-    double bilateralSigmaSpace = 75.0; // Space sigma for bilateral
-    int morphologySize = 0;            // Morphological operation kernel size (0 = disabled)
-    double minContourLength = 10.0;    // Minimum contour arc length
-    int edgeDilation = 0;              // Dilate edges to connect fragments (0 = disabled)
-    int edgeSmoothing = 0;             // Gaussian blur on edge image (0 = disabled)
-    double contourSmoothing = 0.0;     // Contour approximation epsilon (0 = disabled)
-    
-    // Neon effect parameters
-    cv::Scalar neonCenterColor = cv::Scalar(255, 0, 255);   // Magenta (BGR)
-    cv::Scalar neonOtherColor = cv::Scalar(255, 255, 0);    // Cyan (BGR)
-    cv::Scalar neonEdgeColor = cv::Scalar(0, 0, 255);       // Red (BGR)
-    int neonGlowStrength = 3;   // Number of glow layers
-    int neonGlowSize = 15;      // Blur size for glow
-    int neonMaxObjects = 8;      // Color only the largest N objects
-    float neonMinObjectAreaRatio = 0.01f; // Minimum object area as fraction of image (e.g. 0.01 = 1%)
-    int neonJoinSize = 15;       // Kernel size used to connect edges into objects (odd recommended)
-    bool neonPerContour = true;  // If true, every contour gets a unique color (ignores object grouping)
-    bool neonKMeansEnabled = false; // If true, k-means clusters contour centroids into groups
-    int neonKMeansK = 24;           // Initial K for k-means (final groups may be larger)
-    float neonKMeansNearDistancePx = 25.0f; // Only keep k-means grouping when members are within this distance to their center
+    // Stages that must be recomputed by the next processImage()
+    unsigned dirtyStages = STAGE_ALL;
+
+    Params params;
+
+    // A contour from the previous frame, kept for matching against the next one
+    struct TrackedContour {
+        cv::Point2f centroid;
+        double area = 0.0;
+        uint32_t id = 0;
+    };
+
+    // What temporal mode carries from one frame to the next
+    struct TemporalState {
+        std::vector<TrackedContour> contours;
+        cv::Mat referenceEdges;     // Edges each brush block was last drawn from
+        cv::Mat brushStrokeImage;
+        int brushSize = 0;          // Brush params the cached strokes were drawn with
+        int brushDensity = 0;
+        int brushBackend = 0;
+        int seed = 0;
+        int edgeDensityKernel = 0;
+        cv::Mat kmeansCenters;
+        uint32_t nextId = 0;
+    };
+
+    bool temporalCoherence = false;
+    float temporalEdgeThreshold = 0.02f;
+    TemporalState temporal;
+    std::vector<uint32_t> contourIds;   // Stable id of each result contour (temporal or tiled)
+    TileContext tileContext;
+    StrokeRasterizer strokeRasterizer;  // Keeps its stamp atlas between runs
+
+    // What createNeonEffect() leaves for compositeNeon(). Background edges are
+    // one flat color, so they are kept (and blurred) as a single-channel mask
+    // and only tinted when compositing.
+    struct NeonLayers {
+        cv::Mat edgeMask;       // CV_8U, background edges
+        cv::Mat edgeGlow;       // CV_8U, glow of edgeMask
+        cv::Mat contours;       // CV_8UC3 BGR, colored contour lines
+        cv::Mat contourGlow;    // CV_8UC3 BGR
+        cv::Mat core;           // CV_8U white core lines, empty if none
+    };
+    NeonLayers neonLayers;
+
+    // Data that depends on the image alone, derived once per setImage()
+    // instead of on every run. The gray image is made right away since edges
+    // need it first; the gradients only once a run needs the brush stage.
+    // With asyncGradients they come from a task started at the top of that
+    // run, so they overlap edge detection and tracing.
+    struct ImageFeatures {
+        cv::Mat gray;                   // CV_8U luminance
+        cv::Mat gradX;                  // CV_16S 3x3 Sobel of gray (exact, |value| <= 1020)
+        cv::Mat gradY;
+        bool hasGradients = false;
+        std::future<void> gradients;    // Declared last: joins before the Mats go
+    };
+    ImageFeatures features;
+    bool asyncGradients = false;
+
+    void computeGradients();
+
+    // Features with the gradients finished
+    const ImageFeatures& imageFeatures();
+
+    // Gradients of the current image for the blur settings they were made
+    // with, so a Canny threshold change only reruns hysteresis
+    struct EdgeCache {
+        bool valid = false;                 // Cleared by setImage()
+        bool useBilateralFilter = false;
+        int blurStrength = 0;
+        int bilateralD = 0;
+        double bilateralSigmaColor = 0.0;
+        double bilateralSigmaSpace = 0.0;
+        IncrementalCanny canny;
+    };
+    EdgeCache edgeCache;
+
+    // Everything cv::findContours found in the current edge image, so the
+    // area/length thresholds and smoothing can be changed without tracing
+    // the edges again. Smoothed contours are made on demand and kept until
+    // the smoothing epsilon changes.
+    struct ContourCache {
+        bool valid = false;                 // Cleared whenever the edges change
+        std::vector<std::vector<cv::Point>> traced;    // cv::findContours output, reused between runs
+        ContourSet raw;
+        std::vector<int> byArea;            // Indices into raw, by increasing area
+        double epsilon = 0.0;               // Smoothing the memo below is for
+        std::vector<std::vector<cv::Point>> smoothed;
+        std::vector<ContourSet::Features> smoothedFeatures;
+        std::vector<uint8_t> smoothedState; // 0 = not made yet, 1 = made, 2 = too short to keep
+    };
+    ContourCache contourCache;
+
+    template <typename T>
+    void setParam(T& field, const T& val, Stage stage) {
+        if (field == val) return;
+        field = val;
+        invalidate(stage);
+    }
 
+    void prepareEdges();
     void detectEdges();
     void findContours();
+    void matchContours();
+    void assignTileContourIds();
     void createBrushStrokes();
     void createNeonEffect();
+    void compositeNeon();
 };
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+// Canny split at the point where the thresholds come in.
+//
+// prepare() does the threshold-independent work once per blurred image:
+// 3x3 Sobel gradients, L1 magnitude and non-maximum suppression, leaving a
+// map holding the magnitude of every local maximum (0 elsewhere). edges()
+// then only runs hysteresis for a pair of thresholds, formulated as
+// connected components: a candidate pixel (local maximum above the low
+// threshold) is an edge iff its 8-connected candidate component holds a
+// pixel above the high threshold. The labelling is cv::connectedComponents,
+// which runs in parallel.
+//
+// The output matches cv::Canny(blurred, edges, low, high) with the default
+// aperture and L1 gradient.
+class IncrementalCanny {
+public:
+    void prepare(const cv::Mat& blurred);
+    bool isPrepared() const { return !maxima.empty(); }
+
+    void edges(double lowThreshold, double highThreshold, cv::Mat& out);
+
+    // The input to hysteresis, for callers that run it themselves (e.g.
+    // over several tiles): CV_8U, 0 = not a candidate, 1 = candidate not
+    // above the high threshold, 2 = above it
+    void classify(double lowThreshold, double highThreshold, cv::Mat& out) const;
+
+private:
+    cv::Mat maxima;     // CV_16U, gradient magnitude at local maxima, else 0
+    cv::Mat candidates; // Scratch, reused between calls
+    cv::Mat labels;
+};
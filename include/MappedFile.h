@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A scratch file mapped into memory. Its pages are written back to disk under
+// memory pressure instead of counting against RAM, which lets TiledProcessor
+// keep full-resolution intermediates of images far larger than memory.
+// The file is removed when the mapping is closed.
+//
+// openRead() maps an existing file read-only instead (e.g. to decode it in
+// place); that file is left alone.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Create (or truncate) the file at path, size it and map it read/write
+    bool open(const std::string& path, size_t size);
+    // Map an existing file read-only; data() must not be written through
+    bool openRead(const std::string& path);
+    void close();
+
+    uint8_t* data() const { return ptr; }
+    size_t size() const { return length; }
+
+private:
+    std::string path;
+    uint8_t* ptr = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+// Glow for the neon effect: a weighted sum of Gaussian blurs of a layer,
+// saturated back to the layer's 8-bit type.
+//
+// gaussian() blurs the full-resolution layer once per pass, so its cost grows
+// with the kernel size. pyramid() does what bloom does in game engines: it
+// builds a pyrDown pyramid once, blurs each pass at the coarsest level that
+// can still represent it with a small kernel, and folds everything back up
+// with a single pyrUp chain. Each pass keeps the same Gaussian sigma (the
+// pyramid's own binomial filters are counted towards it), so both engines
+// give the same look for the same passes while the pyramid's cost barely
+// depends on the glow radius.
+//
+// composite() is the last step of the neon effect: it tints the edge masks,
+// blends them with the glows and the sharp layers in one row-parallel SIMD
+// pass and writes RGB output directly.
+class NeonGlow {
+public:
+    struct Pass {
+        int kernelSize;     // Odd GaussianBlur kernel size at full resolution
+        double weight;
+    };
+
+    // Deepest pyramid level; tiles aligned to this many pixels see the same
+    // pyramid grid as the whole image
+    static constexpr int kMaxLevels = 5;
+    static constexpr int kAlignment = 1 << kMaxLevels;
+
+    // Passes of the neon glow: glowSize, glowSize + 10, ... with the first at
+    // full weight and the rest at half
+    static std::vector<Pass> passes(int glowSize, int glowStrength);
+
+    static cv::Mat gaussian(const cv::Mat& layer, const std::vector<Pass>& passes);
+    static cv::Mat pyramid(const cv::Mat& layer, const std::vector<Pass>& passes);
+
+    // rgb = 0.6 * edgeGlow * edgeColor + 0.5 * edgeMask * edgeColor
+    //       + 1.2 * contourGlow + contours + 0.5 * core, saturated.
+    // The edge layers and core are single-channel masks (CV_8U, 255 = full
+    // edgeColor or white), contours and contourGlow CV_8UC3; all BGR in, RGB
+    // out, one size. core may be empty.
+    static void composite(const cv::Mat& edgeGlow, const cv::Mat& edgeMask, const cv::Scalar& edgeColor,
+                          const cv::Mat& contourGlow, const cv::Mat& contours,
+                          const cv::Mat& core, cv::Mat& rgb);
+};
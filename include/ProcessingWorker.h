@@ -0,0 +1,97 @@
+#pragma once
+
+#include "ImageProcessor.h"
+#include "ResultCache.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Runs ImageProcessor on a dedicated thread so the UI keeps rendering while
+// the pipeline catches up.
+//
+// The UI posts parameter snapshots with submit(). Only the newest snapshot is
+// kept; posting one also cancels in-flight work at the next stage boundary.
+// Completed results are written into a back buffer owned by the worker and
+// handed to the UI's front buffer through a ready slot, so neither side ever
+// reads a Mat the other one is writing.
+//
+// Preview snapshots (posted while a slider is being dragged) run on a
+// downscaled proxy of the image with scaled parameters, so the viewport
+// follows the slider; the UI posts a full-resolution snapshot on release.
+class ProcessingWorker {
+public:
+    ProcessingWorker();
+    ~ProcessingWorker();
+
+    // Load an image (from the result cache if it has it) and publish it
+    // with whatever stages are already known, then queue a full-resolution
+    // run with the latest parameters on the worker. Only decoding happens on
+    // the calling thread; stages missing from the result are still dirty.
+    bool loadImage(const std::string& filepath);
+
+    // Look images up in (and add them to) a result cache when they are
+    // loaded, so reopening one with the same parameters skips processing
+    void setResultCache(std::unique_ptr<ResultCache> cache);
+
+    // Queue a parameter snapshot, replacing any snapshot not yet started.
+    // A preview runs on the proxy image instead of the full-resolution one.
+    void submit(const ImageProcessor::Params& params, bool preview = false);
+
+    // Stages to compute (ImageProcessor::Stage bits), normally the ones the
+    // viewport shows. Others stay dirty, and their Mats in the result stale,
+    // until they are asked for; asking for more reruns the last snapshot.
+    // Call from the UI thread.
+    void setOutputs(unsigned stages);
+
+    // Swap in the newest completed result, if any. Call once per frame from
+    // the UI thread; returns true when the front buffer changed.
+    bool pollResult();
+
+    // Front buffer, only valid on the UI thread between pollResult() calls
+    const ProcessingResult& getResult() const { return front; }
+    bool hasImage() const { return !front.originalImage.empty(); }
+
+    // True while a snapshot is queued or being processed
+    bool isBusy() const { return busy.load(std::memory_order_relaxed); }
+
+private:
+    ImageProcessor processor;
+    ImageProcessor proxy;           // Downscaled copy for previews
+    double proxyScale = 0.5;        // 1/2, dropping to 1/4 if previews are slow
+    double proxyImageScale = 0.0;   // Scale the proxy's image was built at (0 = none)
+    std::mutex processorMutex;      // Held while either processor is in use
+    std::unique_ptr<ResultCache> resultCache;  // Guarded by processorMutex
+
+    // Cache entry for the image last loaded, stored after its first full
+    // run completes. Guarded by processorMutex.
+    bool loadKeyed = false;
+    ResultCache::Key loadKey;
+    unsigned loadedStages = 0;      // Stages the cache already had
+
+    std::thread thread;
+    std::mutex queueMutex;
+    std::condition_variable queueCond;
+    ImageProcessor::Params pendingParams;
+    bool pendingPreview = false;
+    bool hasPending = false;
+    unsigned outputs = ImageProcessor::STAGE_ALL;
+    bool stopping = false;
+    std::atomic<bool> cancel{false};
+    std::atomic<bool> busy{false};
+
+    // Result buffers: back is written by the worker, front is read by the UI
+    ProcessingResult back;
+    ProcessingResult ready;
+    ProcessingResult front;
+    std::mutex resultMutex;
+    bool hasReady = false;
+    uint64_t published = 0;         // Generation counter shared by both processors
+
+    void run();
+    void runPreview(const ImageProcessor::Params& params, unsigned stages);
+    void publish(const ProcessingResult& r, float scale);
+    void storeLoaded(const ImageProcessor::Params& params);
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <GL/glew.h>
@@ -13,10 +15,10 @@ public:
     // Initialize renderer
     void init();
 
-    // Render image with contours
-    void renderImage(const cv::Mat& image);
-    void renderEdges(const cv::Mat& edgeImage);
-    void renderContours(const cv::Mat& image, const std::vector<std::vector<cv::Point>>& contours);
+    // Render a view into the current display mode's texture. `version`
+    // identifies the content (see ViewCache::view): while it stays the same,
+    // the texture from last time is drawn and nothing is uploaded.
+    void renderImage(const cv::Mat& image, uint64_t version);
 
     // Display modes
     enum DisplayMode {
@@ -25,29 +27,35 @@ public:
         CONTOURS,
         BRUSH_STROKES,
         COMBINED,
-        NEON
+        NEON,
+        MODE_COUNT
     };
 
     void setDisplayMode(DisplayMode mode) { displayMode = mode; }
     DisplayMode getDisplayMode() const { return displayMode; }
 
-    // Stroke settings
-    void setStrokeColor(float r, float g, float b, float a = 1.0f);
-    void setStrokeWidth(float width) { strokeWidth = width; }
-
-    GLuint getTextureID() const { return textureID; }
+    GLuint getTextureID() const { return textures[displayMode].id; }
 
 private:
+    // One texture per display mode, kept between frames and streamed
+    // through a pixel buffer object
+    struct ModeTexture {
+        GLuint id = 0;
+        GLuint pbo = 0;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        bool loaded = false;
+        uint64_t version = 0;
+    };
+
     GLuint VAO, VBO, EBO;
     GLuint shaderProgram;
-    GLuint textureID;
+    std::array<ModeTexture, MODE_COUNT> textures;
     DisplayMode displayMode;
 
-    float strokeColor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
-    float strokeWidth = 2.0f;
-
     void createShaders();
     void setupQuad();
-    GLuint loadTexture(const cv::Mat& image);
-    void drawContourStroke(const std::vector<std::vector<cv::Point>>& contours);
+    void upload(ModeTexture& texture, const cv::Mat& image, uint64_t version);
+    void draw();
 };
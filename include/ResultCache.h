@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ImageProcessor.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Persistent cache of pipeline results on disk, shared by the GUI and batch
+// mode. An entry is keyed by a hash of the input file's bytes and a hash of
+// every processing parameter (seed included), so the same image processed
+// with the same settings is only ever computed once.
+//
+// Entries hold the original image, edge map, contours and the brush and neon
+// renders, whichever of them were current, in a flat binary file that is
+// memory-mapped on a hit. Each entry carries a hash of its payload that is
+// checked on every hit; damaged entries are deleted. The directory is kept
+// under a size limit by deleting the least recently used entries; a hit
+// counts as a use.
+//
+// load() and store() may be called from any thread.
+class ResultCache {
+public:
+    struct Key {
+        uint64_t input = 0;     // Hash of the input file's bytes
+        uint64_t params = 0;    // Hash of ImageProcessor::serializeParams()
+    };
+
+    // Creates the directory if needed
+    ResultCache(const std::string& directory, uint64_t maxBytes);
+
+    bool isOpen() const { return open; }
+
+    // Hash the bytes of an input file; false if it cannot be read
+    static bool hashFile(const std::string& filepath, uint64_t& hash);
+    static Key makeKey(uint64_t inputHash, const ImageProcessor::Params& params);
+
+    // Fill `result` from the entry for key. Its `stages` tell which outputs
+    // were stored; the others are empty. Returns false on a miss.
+    bool load(const Key& key, ProcessingResult& result);
+
+    // Write (or replace) the entry for key with the current stages of result
+    void store(const Key& key, const ProcessingResult& result);
+
+private:
+    std::string directory;
+    uint64_t maxBytes;
+    bool open = false;
+
+    std::mutex mutex;           // Guards totalBytes and eviction
+    uint64_t totalBytes = 0;    // Size of all entries, as of the last scan plus stores since
+
+    std::string entryPath(const Key& key) const;
+    void evict();               // Call with mutex held
+};
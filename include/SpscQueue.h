@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Wait strategy for polling loops: yield first, then sleep briefly so an idle
+// stage does not keep a core busy
+inline void spscBackoff(int& spins) {
+    if (++spins < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+// Bounded lock-free ring buffer for exactly one producer thread and one
+// consumer thread. The blocking helpers poll with spscBackoff(), which suits
+// the video pipeline where every stage is busy most of the time.
+//
+// Only the producer closes the queue, to say no more items are coming. The
+// consumer must keep popping until pop() returns false: push() waits for
+// space for as long as it takes, so a consumer that stops early would leave
+// its producer waiting forever.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        // One slot stays empty to tell "full" from "empty"
+        size_t size = 2;
+        while (size < capacity + 1) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    // Producer side. Leaves item untouched when the queue is full.
+    bool tryPush(T& item) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        const size_t next = (h + 1) & mask;
+        if (next == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        slots[h] = std::move(item);
+        head.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool tryPop(T& item) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(slots[t]);
+        tail.store((t + 1) & mask, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side; waits until there is space
+    void push(T& item) {
+        int spins = 0;
+        while (!tryPush(item)) {
+            spscBackoff(spins);
+        }
+    }
+
+    // Returns false once the producer has closed the queue and it is drained
+    bool pop(T& item) {
+        int spins = 0;
+        while (!tryPop(item)) {
+            if (closed.load(std::memory_order_acquire)) {
+                // Items pushed right before close() are still visible here
+                return tryPop(item);
+            }
+            spscBackoff(spins);
+        }
+        return true;
+    }
+
+    // Producer side, after its last push()
+    void close() { closed.store(true, std::memory_order_release); }
+    bool isClosed() const { return closed.load(std::memory_order_acquire); }
+
+private:
+    std::vector<T> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0};    // Written by the producer
+    alignas(64) std::atomic<size_t> tail{0};    // Written by the consumer
+    alignas(64) std::atomic<bool> closed{false};
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <unordered_map>
+
+// Draws anti-aliased gray line strokes by stamping pre-rendered coverage
+// masks instead of rasterizing every stroke with cv::line.
+//
+// Stamps are rendered on first use with cv::line(LINE_AA) and cached in an
+// atlas keyed by quantized angle, length and thickness. Drawing a stroke is
+// then a SIMD max of the stamp (scaled by the stroke's gray level) into a
+// single-channel canvas. Strokes longer than the longest stamp are split
+// into equal pieces.
+class StrokeRasterizer {
+public:
+    // Start a new canvas of the given size, cleared to black
+    void begin(cv::Size size);
+
+    // Draw a stroke from p1 to p2
+    void draw(cv::Point2f p1, cv::Point2f p2, int gray, int thickness);
+
+    // Single-channel result of the strokes drawn since begin()
+    const cv::Mat& canvas() const { return target; }
+
+private:
+    struct Stamp {
+        cv::Mat coverage;       // CV_8U, 255 = fully covered
+        cv::Point2f center;     // Stroke midpoint in stamp coordinates
+    };
+
+    static constexpr int kAngleBins = 64;       // Over [0, pi); a stroke has no direction
+    static constexpr int kMaxLength = 64;       // Longest stamp, in pixels
+    static constexpr int kMaxThickness = 32;
+    static constexpr size_t kMaxStamps = 16384; // Atlas is cleared past this
+
+    const Stamp& stamp(int angleBin, int length, int thickness);
+    void blit(const Stamp& s, cv::Point2f midpoint, int gray);
+
+    std::unordered_map<uint32_t, Stamp> atlas;
+    cv::Mat target;
+};
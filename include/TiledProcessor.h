@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ImageProcessor.h"
+#include <string>
+
+// Processes a single image at full resolution, without the 1024px cap, by
+// splitting it into tiles.
+//
+// The decoded image, a global contour-label map and the output all live in
+// memory-mapped scratch files, so only the tiles currently being worked on
+// are resident. Each tile is processed with a halo wide enough for the
+// largest kernel in use, and only its core is kept, so the stitched result
+// has no seams. Canny's hysteresis is not local, so a first pass runs it over
+// the whole image: candidate components are labelled per tile and merged
+// across tile borders (union-find), and each tile later reads its edges from
+// the resulting map. A second pass labels edge components the same way; the
+// third gives every tile those global labels, so a contour keeps one neon
+// color across tiles. Per-contour grouping runs once on the global
+// components, for the same reason.
+class TiledProcessor {
+public:
+    struct Options {
+        std::string inputPath;
+        std::string outputPath;
+        std::string scratchDir;         // Empty = system temp directory
+        int displayMode = 5;            // Same numbering as ImageProcessor::composeView
+        int tileSize = 1024;            // Core size of a tile, before the halo
+        int threads = 0;                // Tiles processed at once (0 = one per core)
+        ImageProcessor::Params params;
+    };
+
+    explicit TiledProcessor(const Options& options);
+
+    // Returns false if the input could not be read or the output written
+    bool run();
+
+    // Pixels of context each tile needs on every side for these params
+    static int haloSize(const ImageProcessor::Params& params);
+
+private:
+    Options options;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "ImageProcessor.h"
+#include <string>
+
+// Applies a display mode to every frame of a video file.
+//
+// One thread decodes with cv::VideoCapture, a group of worker threads each
+// run their own ImageProcessor, and one thread encodes with cv::VideoWriter.
+// Stages are connected by bounded lock-free SPSC queues (one pair per
+// worker), and the encoder reorders finished frames by index, so several
+// frames are in flight at once and throughput tracks the slowest stage.
+//
+// With temporal coherence on, every frame goes through a single processor in
+// order so it can reuse state from the previous frame (see
+// ImageProcessor::setTemporalCoherence); parallelism then comes from
+// OpenCV's own threading inside each stage.
+class VideoProcessor {
+public:
+    struct Options {
+        std::string inputPath;
+        std::string outputPath;
+        std::string fourcc;             // Empty = pick from the output extension
+        int displayMode = 5;            // Same numbering as ImageProcessor::composeView
+        int threads = 0;                // Process threads (0 = one per core)
+        bool temporal = false;          // Reuse work between consecutive frames
+        ImageProcessor::Params params;
+    };
+
+    explicit VideoProcessor(const Options& options);
+
+    // Returns false if the input or output could not be opened
+    bool run();
+
+private:
+    Options options;
+};
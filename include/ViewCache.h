@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ImageProcessor.h"
+#include <opencv2/opencv.hpp>
+#include <array>
+#include <cstdint>
+
+// The image each display mode shows, built from a ProcessingResult once and
+// reused until its inputs change. The viewport and "Save Image" both read
+// from here, so neither redraws a view that is already up to date.
+//
+// Original, Edges, Brush Strokes and Neon are the result's own Mats; only
+// Contours and Combined draw anything. Entries are keyed by the result's
+// generation and, for those two, the stroke settings. A view's pixels are
+// never written after it is returned (a rebuild allocates a new buffer), so
+// callers may keep a reference-counted header to it.
+class ViewCache {
+public:
+    // Same numbering as Renderer::DisplayMode and ImageProcessor::composeView
+    static constexpr int kModeCount = 6;
+
+    // Image for `displayMode` (RGB, or grayscale for Edges). `version`, if
+    // given, receives a number that changes whenever the pixels may have.
+    // The reference is valid until the next call or until `result` changes.
+    const cv::Mat& view(const ProcessingResult& result, int displayMode, uint64_t* version = nullptr);
+
+    // Contours: line width of the hued outlines. Combined: line color (RGB 0-1)
+    void setStrokeWidth(float width);
+    void setStrokeColor(float r, float g, float b);
+
+private:
+    struct Entry {
+        bool valid = false;
+        uint64_t generation = 0;
+        uint64_t version = 0;
+        cv::Mat image;          // Only Contours and Combined keep pixels here
+    };
+
+    std::array<Entry, kModeCount> entries;
+    uint64_t versions = 0;
+
+    float strokeWidth = 2.0f;
+    cv::Scalar strokeColor{255, 255, 255};
+
+    void build(const ProcessingResult& result, int displayMode, Entry& entry);
+};
@@ -1,10 +1,16 @@
 #include "App.h"
+#include "ExportQueue.h"
 #include "ImageProcessor.h"
+#include "ProcessingWorker.h"
 #include "Renderer.h"
+#include "ResultCache.h"
+#include "ViewCache.h"
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 #include <tinyfiledialogs.h>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <filesystem>
 
@@ -13,8 +19,12 @@ namespace fs = std::filesystem;
 App::App(int width, int height)
     : window(nullptr), windowWidth(width), windowHeight(height), running(true) {
     
-    imageProcessor = std::make_unique<ImageProcessor>();
+    worker = std::make_unique<ProcessingWorker>();
     renderer = std::make_unique<Renderer>();
+    viewCache = std::make_unique<ViewCache>();
+    // One encoder per display mode, so "Export All Modes" runs them at once
+    exportQueue = std::make_unique<ExportQueue>(ViewCache::kModeCount);
+    setDisplayMode(Renderer::BRUSH_STROKES);
 
     initOpenGL();
     initImGui();
@@ -125,6 +135,15 @@ bool App::isRunning() const {
 void App::processFrame() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // Pick up the newest finished result; the pipeline itself runs on the
+    // worker thread so this frame never waits for it.
+    worker->pollResult();
+    const ProcessingResult& result = worker->getResult();
+
+    // UI-side copy of the parameters, posted to the worker when edited
+    static ImageProcessor::Params params;
+    bool paramsChanged = false;
+
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -162,109 +181,210 @@ void App::processFrame() {
         loadImage(filepath);
     }
     
-    // Save button
-    if (imageProcessor->hasImage()) {
+    // Save buttons. Encoding runs on the export queue, off the UI thread.
+    static EncodeOptions encodeOptions;
+    static std::string exportAllPath;   // Set while waiting for every stage
+    if (worker->hasImage()) {
+        const char* saveFilterPatterns[] = { "*.png", "*.jpg", "*.webp", "*.bmp" };
         if (ImGui::Button("Save Image...", ImVec2(-1, 0))) {
-            const char* saveFilterPatterns[] = { "*.png", "*.jpg", "*.bmp" };
             char* savePath = tinyfd_saveFileDialog(
                 "Save Image As",
                 "output.png",
-                3,
+                4,
                 saveFilterPatterns,
-                "Image Files (*.png, *.jpg, *.bmp)"
+                "Image Files (*.png, *.jpg, *.webp, *.bmp)"
             );
             if (savePath) {
                 int currentDisplayMode = static_cast<int>(renderer->getDisplayMode());
-                if (imageProcessor->saveImage(savePath, currentDisplayMode)) {
-                    std::cout << "Image saved successfully: " << savePath << std::endl;
+                // The view on screen, without drawing it again
+                const cv::Mat& view = viewCache->view(result, currentDisplayMode);
+                const unsigned needed = ImageProcessor::viewStages(currentDisplayMode);
+                if (!view.empty() && (result.stages & needed) == needed) {
+                    exportQueue->push(savePath, view, encodeOptions);
                 } else {
                     std::cerr << "Failed to save image: " << savePath << std::endl;
                 }
             }
         }
+        if (ImGui::Button("Export All Modes...", ImVec2(-1, 0))) {
+            char* savePath = tinyfd_saveFileDialog(
+                "Export All Modes As",
+                "output.png",
+                4,
+                saveFilterPatterns,
+                "Image Files (*.png, *.jpg, *.webp, *.bmp)"
+            );
+            if (savePath) {
+                // Views other than the current one may be stale; have the
+                // worker compute everything and export once it has
+                exportAllPath = savePath;
+                worker->setOutputs(ImageProcessor::STAGE_ALL);
+            }
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Writes one file per display mode, named <name>_<mode>.<ext>");
+        }
+
+        if (!exportAllPath.empty() && !worker->isBusy() && result.scale == 1.0f &&
+            result.stages == ImageProcessor::STAGE_ALL) {
+            static const char* const modeNames[] = {"original", "edges", "contours", "brush", "combined", "neon"};
+            const std::filesystem::path base(exportAllPath);
+            for (int mode = 0; mode < ViewCache::kModeCount; ++mode) {
+                const std::filesystem::path path = base.parent_path() /
+                    (base.stem().string() + "_" + modeNames[mode] + base.extension().string());
+                const cv::Mat& view = viewCache->view(result, mode);
+                if (!view.empty()) {
+                    exportQueue->push(path.string(), view, encodeOptions);
+                }
+            }
+            exportAllPath.clear();
+            // Back to computing only what is on screen
+            setDisplayMode(renderer->getDisplayMode());
+        }
+
+        const ExportQueue::Progress exports = exportQueue->progress();
+        if (!exportAllPath.empty()) {
+            ImGui::TextDisabled("Preparing all modes...");
+        } else if (exports.done < exports.total) {
+            char overlay[32];
+            snprintf(overlay, sizeof(overlay), "Saving %d/%d", exports.done, exports.total);
+            ImGui::ProgressBar(static_cast<float>(exports.done) / exports.total, ImVec2(-1, 0), overlay);
+        } else if (exports.failed > 0) {
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%d of %d exports failed", exports.failed, exports.total);
+        }
+
+        if (ImGui::CollapsingHeader("Export Settings")) {
+            ImGui::SliderInt("PNG Compression", &encodeOptions.pngCompression, 0, 9);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("0 = fastest, 9 = smallest file; PNG is lossless either way");
+            }
+            ImGui::SliderInt("JPEG Quality", &encodeOptions.jpegQuality, 0, 100);
+            ImGui::Checkbox("WebP Lossless", &encodeOptions.webpLossless);
+            if (!encodeOptions.webpLossless) {
+                ImGui::SliderInt("WebP Quality", &encodeOptions.webpQuality, 1, 100);
+            }
+        }
     }
 
-    if (imageProcessor->hasImage()) {
+    // Presets share the format used by `--batch --params`
+    const char* presetFilterPatterns[] = { "*.json", "*.yml" };
+    if (ImGui::Button("Load Preset...", ImVec2(140, 0))) {
+        char* presetPath = tinyfd_openFileDialog(
+            "Load Preset",
+            "",
+            2,
+            presetFilterPatterns,
+            "Presets (*.json, *.yml)",
+            0
+        );
+        if (presetPath && ImageProcessor::loadParams(presetPath, params)) {
+            paramsChanged = true;
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Save Preset...", ImVec2(-1, 0))) {
+        char* presetPath = tinyfd_saveFileDialog(
+            "Save Preset As",
+            "preset.json",
+            2,
+            presetFilterPatterns,
+            "Presets (*.json, *.yml)"
+        );
+        if (presetPath && ImageProcessor::saveParams(presetPath, params)) {
+            std::cout << "Preset saved successfully: " << presetPath << std::endl;
+        }
+    }
+
+    if (worker->hasImage()) {
         ImGui::Separator();
-        ImGui::Text("Image: %dx%d", imageProcessor->getWidth(), imageProcessor->getHeight());
+        ImGui::Text("Image: %dx%d",
+                    static_cast<int>(std::lround(result.originalImage.cols / result.scale)),
+                    static_cast<int>(std::lround(result.originalImage.rows / result.scale)));
+        if (result.scale < 1.0f) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(preview 1/%d)", static_cast<int>(std::lround(1.0f / result.scale)));
+        } else if (worker->isBusy()) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(processing...)");
+        }
 
         // Display mode selection
-        static int displayMode = 3; // BRUSH_STROKES
+        int displayMode = static_cast<int>(renderer->getDisplayMode());
         const char* modes[] = {"Original", "Edges", "Contours", "Brush Strokes", "Combined", "Neon"};
         if (ImGui::Combo("Display Mode", &displayMode, modes, 6)) {
-            renderer->setDisplayMode(static_cast<Renderer::DisplayMode>(displayMode));
+            setDisplayMode(displayMode);
         }
 
         ImGui::Separator();
         ImGui::Text("Edge Detection Parameters");
 
-        double threshold1 = imageProcessor->getCannyThreshold1();
-        double threshold2 = imageProcessor->getCannyThreshold2();
-        double minArea = imageProcessor->getContourMinArea();
+        double threshold1 = params.cannyThreshold1;
+        double threshold2 = params.cannyThreshold2;
+        double minArea = params.contourMinArea;
 
         float t1 = static_cast<float>(threshold1);
         if (ImGui::SliderFloat("Canny T1", &t1, 10, 200)) {
-            imageProcessor->setCannyThreshold1(t1);
-            imageProcessor->processImage();
+            params.cannyThreshold1 = t1;
+            paramsChanged = true;
         }
 
         float t2 = static_cast<float>(threshold2);
         if (ImGui::SliderFloat("Canny T2", &t2, 50, 400)) {
-            imageProcessor->setCannyThreshold2(t2);
-            imageProcessor->processImage();
+            params.cannyThreshold2 = t2;
+            paramsChanged = true;
         }
 
         float ma = static_cast<float>(minArea);
         if (ImGui::SliderFloat("Min Contour Area", &ma, 1, 1000)) {
-            imageProcessor->setContourMinArea(ma);
-            imageProcessor->processImage();
+            params.contourMinArea = ma;
+            paramsChanged = true;
         }
 
-        float mcl = static_cast<float>(imageProcessor->getMinContourLength());
+        float mcl = static_cast<float>(params.minContourLength);
         if (ImGui::SliderFloat("Min Contour Length", &mcl, 1, 200)) {
-            imageProcessor->setMinContourLength(mcl);
-            imageProcessor->processImage();
+            params.minContourLength = mcl;
+            paramsChanged = true;
         }
 
         ImGui::Separator();
         ImGui::Text("Noise Reduction");
 
-        int blurStrength = imageProcessor->getBlurStrength();
+        int blurStrength = params.blurStrength;
         if (ImGui::SliderInt("Blur Strength", &blurStrength, 1, 21)) {
-            imageProcessor->setBlurStrength(blurStrength);
-            imageProcessor->processImage();
+            params.blurStrength = blurStrength;
+            paramsChanged = true;
         }
 
-        bool useBilateral = imageProcessor->getBilateralFilter();
+        bool useBilateral = params.useBilateralFilter;
         if (ImGui::Checkbox("Bilateral Filter", &useBilateral)) {
-            imageProcessor->setBilateralFilter(useBilateral);
-            imageProcessor->processImage();
+            params.useBilateralFilter = useBilateral;
+            paramsChanged = true;
         }
 
         if (useBilateral) {
-            int bilateralD = imageProcessor->getBilateralD();
+            int bilateralD = params.bilateralD;
             if (ImGui::SliderInt("Bilateral Diameter", &bilateralD, 3, 21)) {
-                imageProcessor->setBilateralD(bilateralD);
-                imageProcessor->processImage();
+                params.bilateralD = bilateralD;
+                paramsChanged = true;
             }
 
-            float sigmaColor = static_cast<float>(imageProcessor->getBilateralSigmaColor());
+            float sigmaColor = static_cast<float>(params.bilateralSigmaColor);
             if (ImGui::SliderFloat("Sigma Color", &sigmaColor, 10, 200)) {
-                imageProcessor->setBilateralSigmaColor(sigmaColor);
-                imageProcessor->processImage();
+                params.bilateralSigmaColor = sigmaColor;
+                paramsChanged = true;
             }
 
-            float sigmaSpace = static_cast<float>(imageProcessor->getBilateralSigmaSpace());
+            float sigmaSpace = static_cast<float>(params.bilateralSigmaSpace);
             if (ImGui::SliderFloat("Sigma Space", &sigmaSpace, 10, 200)) {
-                imageProcessor->setBilateralSigmaSpace(sigmaSpace);
-                imageProcessor->processImage();
+                params.bilateralSigmaSpace = sigmaSpace;
+                paramsChanged = true;
             }
         }
 
-        int morphSize = imageProcessor->getMorphologySize();
+        int morphSize = params.morphologySize;
         if (ImGui::SliderInt("Morphology Size", &morphSize, 0, 7)) {
-            imageProcessor->setMorphologySize(morphSize);
-            imageProcessor->processImage();
+            params.morphologySize = morphSize;
+            paramsChanged = true;
         }
         if (ImGui::IsItemHovered()) {
             ImGui::SetTooltip("Cleanup small noise with morphological ops (0=off)");
@@ -273,28 +393,28 @@ void App::processFrame() {
         ImGui::Separator();
         ImGui::Text("Edge Smoothing");
 
-        int edgeDilation = imageProcessor->getEdgeDilation();
+        int edgeDilation = params.edgeDilation;
         if (ImGui::SliderInt("Edge Dilation", &edgeDilation, 0, 7)) {
-            imageProcessor->setEdgeDilation(edgeDilation);
-            imageProcessor->processImage();
+            params.edgeDilation = edgeDilation;
+            paramsChanged = true;
         }
         if (ImGui::IsItemHovered()) {
             ImGui::SetTooltip("Connect fragmented edges (hair, fine details)");
         }
 
-        int edgeSmoothing = imageProcessor->getEdgeSmoothing();
+        int edgeSmoothing = params.edgeSmoothing;
         if (ImGui::SliderInt("Edge Blur", &edgeSmoothing, 0, 11)) {
-            imageProcessor->setEdgeSmoothing(edgeSmoothing);
-            imageProcessor->processImage();
+            params.edgeSmoothing = edgeSmoothing;
+            paramsChanged = true;
         }
         if (ImGui::IsItemHovered()) {
             ImGui::SetTooltip("Smooth jagged edges (0=off)");
         }
 
-        float contourSmooth = static_cast<float>(imageProcessor->getContourSmoothing());
+        float contourSmooth = static_cast<float>(params.contourSmoothing);
         if (ImGui::SliderFloat("Contour Smoothing", &contourSmooth, 0.0f, 10.0f)) {
-            imageProcessor->setContourSmoothing(contourSmooth);
-            imageProcessor->processImage();
+            params.contourSmoothing = contourSmooth;
+            paramsChanged = true;
         }
         if (ImGui::IsItemHovered()) {
             ImGui::SetTooltip("Simplify contour curves (0=off)");
@@ -303,16 +423,35 @@ void App::processFrame() {
         ImGui::Separator();
         ImGui::Text("Brush Stroke Settings");
 
-        int brushSize = imageProcessor->getBrushSize();
+        int brushSize = params.brushSize;
         if (ImGui::SliderInt("Brush Size", &brushSize, 1, 15)) {
-            imageProcessor->setBrushSize(brushSize);
-            imageProcessor->processImage();
+            params.brushSize = brushSize;
+            paramsChanged = true;
         }
 
-        int brushDensity = imageProcessor->getBrushDensity();
+        int brushDensity = params.brushDensity;
         if (ImGui::SliderInt("Brush Density", &brushDensity, 1, 20)) {
-            imageProcessor->setBrushDensity(brushDensity);
-            imageProcessor->processImage();
+            params.brushDensity = brushDensity;
+            paramsChanged = true;
+        }
+
+        int brushBackend = params.brushBackend;
+        const char* brushBackends[] = {"OpenCV Lines", "Stamp Atlas"};
+        if (ImGui::Combo("Stroke Renderer", &brushBackend, brushBackends, 2)) {
+            params.brushBackend = brushBackend;
+            paramsChanged = true;
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Stamp Atlas reuses pre-rendered strokes; much faster on detailed images");
+        }
+
+        int seed = params.seed;
+        if (ImGui::InputInt("Seed", &seed)) {
+            params.seed = seed;
+            paramsChanged = true;
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Stroke jitter seed; the same seed and settings always give the same image");
         }
 
         ImGui::Separator();
@@ -320,98 +459,126 @@ void App::processFrame() {
 
         static float strokeColor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
         if (ImGui::ColorEdit4("Stroke Color", strokeColor)) {
-            renderer->setStrokeColor(strokeColor[0], strokeColor[1], strokeColor[2], strokeColor[3]);
+            viewCache->setStrokeColor(strokeColor[0], strokeColor[1], strokeColor[2]);
         }
 
         static float strokeWidth = 2.0f;
         if (ImGui::SliderFloat("Stroke Width", &strokeWidth, 1.0f, 10.0f)) {
-            renderer->setStrokeWidth(strokeWidth);
+            viewCache->setStrokeWidth(strokeWidth);
         }
 
         ImGui::Separator();
         ImGui::Text("Neon Effect Settings");
 
-        bool perContour = imageProcessor->getNeonPerContour();
+        bool perContour = params.neonPerContour;
         if (ImGui::Checkbox("Per-Contour Colors", &perContour)) {
-            imageProcessor->setNeonPerContour(perContour);
-            imageProcessor->processImage();
+            params.neonPerContour = perContour;
+            paramsChanged = true;
         }
         if (ImGui::IsItemHovered()) {
             ImGui::SetTooltip("When enabled, every contour gets a unique color (no object grouping)");
         }
 
         if (perContour) {
-            bool kmeansEnabled = imageProcessor->getNeonKMeansEnabled();
+            bool kmeansEnabled = params.neonKMeansEnabled;
             if (ImGui::Checkbox("Group Nearby (K-Means)", &kmeansEnabled)) {
-                imageProcessor->setNeonKMeansEnabled(kmeansEnabled);
-                imageProcessor->processImage();
+                params.neonKMeansEnabled = kmeansEnabled;
+                paramsChanged = true;
             }
             if (ImGui::IsItemHovered()) {
                 ImGui::SetTooltip("Run k-means on contour centroids, but only keep groups when they are very close");
             }
 
             if (kmeansEnabled) {
-                int k = imageProcessor->getNeonKMeansK();
-                if (ImGui::SliderInt("K-Means K", &k, 1, 128)) {
-                    imageProcessor->setNeonKMeansK(k);
-                    imageProcessor->processImage();
+                int grouping = params.neonGroupingBackend;
+                const char* groupings[] = {"K-Means", "Grid Radius"};
+                if (ImGui::Combo("Grouping", &grouping, groupings, 2)) {
+                    params.neonGroupingBackend = grouping;
+                    paramsChanged = true;
                 }
                 if (ImGui::IsItemHovered()) {
-                    ImGui::SetTooltip("Higher K reduces forced merging of far contours");
+                    ImGui::SetTooltip("Grid Radius links contours closer than Near Distance; near-linear, deterministic");
                 }
 
-                float nearPx = imageProcessor->getNeonKMeansNearDistancePx();
+                if (grouping == ImageProcessor::GROUPING_KMEANS) {
+                    int k = params.neonKMeansK;
+                    if (ImGui::SliderInt("K-Means K", &k, 1, 128)) {
+                        params.neonKMeansK = k;
+                        paramsChanged = true;
+                    }
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("Higher K reduces forced merging of far contours");
+                    }
+                }
+
+                float nearPx = params.neonKMeansNearDistancePx;
                 if (ImGui::SliderFloat("Near Distance (px)", &nearPx, 1.0f, 200.0f, "%.1f")) {
-                    imageProcessor->setNeonKMeansNearDistancePx(nearPx);
-                    imageProcessor->processImage();
+                    params.neonKMeansNearDistancePx = nearPx;
+                    paramsChanged = true;
                 }
                 if (ImGui::IsItemHovered()) {
-                    ImGui::SetTooltip("Only contours within this distance of their cluster center stay grouped");
+                    ImGui::SetTooltip(grouping == ImageProcessor::GROUPING_GRID
+                                          ? "Contours whose centers are within this distance (directly or in a chain) share a color"
+                                          : "Only contours within this distance of their cluster center stay grouped");
                 }
             }
         }
 
-        static float neonEdgeColor[3] = {1.0f, 0.0f, 0.0f};    // Red
+        float neonEdgeColor[3] = {
+            static_cast<float>(params.neonEdgeColor[2] / 255.0),
+            static_cast<float>(params.neonEdgeColor[1] / 255.0),
+            static_cast<float>(params.neonEdgeColor[0] / 255.0)
+        };
         if (ImGui::ColorEdit3("Background Edges", neonEdgeColor)) {
-            imageProcessor->setNeonEdgeColor(neonEdgeColor[0], neonEdgeColor[1], neonEdgeColor[2]);
-            imageProcessor->processImage();
+            params.neonEdgeColor = cv::Scalar(neonEdgeColor[2] * 255, neonEdgeColor[1] * 255, neonEdgeColor[0] * 255); // BGR
+            paramsChanged = true;
         }
 
-        int glowStrength = imageProcessor->getNeonGlowStrength();
+        int glowStrength = params.neonGlowStrength;
         if (ImGui::SliderInt("Glow Layers", &glowStrength, 1, 5)) {
-            imageProcessor->setNeonGlowStrength(glowStrength);
-            imageProcessor->processImage();
+            params.neonGlowStrength = glowStrength;
+            paramsChanged = true;
         }
 
-        int glowSize = imageProcessor->getNeonGlowSize();
+        int glowSize = params.neonGlowSize;
         if (ImGui::SliderInt("Glow Size", &glowSize, 1, 31)) {
-            imageProcessor->setNeonGlowSize(glowSize);
-            imageProcessor->processImage();
+            params.neonGlowSize = glowSize;
+            paramsChanged = true;
+        }
+
+        int glowBackend = params.neonGlowBackend;
+        const char* glowBackends[] = {"Gaussian", "Pyramid"};
+        if (ImGui::Combo("Glow Engine", &glowBackend, glowBackends, 2)) {
+            params.neonGlowBackend = glowBackend;
+            paramsChanged = true;
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Pyramid blurs at reduced resolution; same look, cost independent of glow size");
         }
 
         if (!perContour) {
-            int maxObjects = imageProcessor->getNeonMaxObjects();
+            int maxObjects = params.neonMaxObjects;
             if (ImGui::SliderInt("Main Objects", &maxObjects, 1, 12)) {
-                imageProcessor->setNeonMaxObjects(maxObjects);
-                imageProcessor->processImage();
+                params.neonMaxObjects = maxObjects;
+                paramsChanged = true;
             }
             if (ImGui::IsItemHovered()) {
                 ImGui::SetTooltip("Color only the largest N objects; everything else becomes background");
             }
 
-            float minAreaRatio = imageProcessor->getNeonMinObjectAreaRatio();
+            float minAreaRatio = params.neonMinObjectAreaRatio;
             if (ImGui::SliderFloat("Min Object Area", &minAreaRatio, 0.001f, 0.10f, "%.3f")) {
-                imageProcessor->setNeonMinObjectAreaRatio(minAreaRatio);
-                imageProcessor->processImage();
+                params.neonMinObjectAreaRatio = minAreaRatio;
+                paramsChanged = true;
             }
             if (ImGui::IsItemHovered()) {
                 ImGui::SetTooltip("Minimum object size as a fraction of the image (higher removes small clutter)");
             }
 
-            int joinSize = imageProcessor->getNeonJoinSize();
+            int joinSize = params.neonJoinSize;
             if (ImGui::SliderInt("Object Join", &joinSize, 3, 51)) {
-                imageProcessor->setNeonJoinSize(joinSize);
-                imageProcessor->processImage();
+                params.neonJoinSize = joinSize;
+                paramsChanged = true;
             }
             if (ImGui::IsItemHovered()) {
                 ImGui::SetTooltip("Connect nearby edges into one object (too high can merge everything)");
@@ -419,36 +586,45 @@ void App::processFrame() {
         }
 
         ImGui::Separator();
-        ImGui::Text("Contours found: %zu", imageProcessor->getContours().size());
+        ImGui::Text("Contours found: %zu", result.contours.size());
     }
 
+    // While a slider is held, run on the proxy image; once it is released,
+    // post the same snapshot again at full resolution
+    static bool previewShown = false;
+    const bool interacting = ImGui::IsAnyItemActive();
+
     ImGui::End();
 
+    if (paramsChanged) {
+        worker->submit(params, interacting);
+        previewShown = interacting;
+    } else if (previewShown && !interacting) {
+        worker->submit(params);
+        previewShown = false;
+    }
+
     // Render the image
-    if (imageProcessor->hasImage()) {
+    if (worker->hasImage()) {
         ImGui::SetNextWindowPos(ImVec2(320, 10), ImGuiCond_FirstUseEver);
         ImGui::SetNextWindowSize(ImVec2(950, 700), ImGuiCond_FirstUseEver);
         ImGui::Begin("Viewport");
 
-        Renderer::DisplayMode mode = renderer->getDisplayMode();
-        if (mode == Renderer::ORIGINAL) {
-            renderer->renderImage(imageProcessor->getOriginalImage());
-        } else if (mode == Renderer::EDGES) {
-            renderer->renderEdges(imageProcessor->getEdgeImage());
-        } else if (mode == Renderer::CONTOURS) {
-            renderer->renderContours(imageProcessor->getOriginalImage(), imageProcessor->getContours());
-        } else if (mode == Renderer::BRUSH_STROKES) {
-            renderer->renderImage(imageProcessor->getBrushStrokeImage());
-        } else if (mode == Renderer::NEON) {
-            renderer->renderImage(imageProcessor->getNeonImage());
-        } else { // COMBINED
-            cv::Mat combined = imageProcessor->getBrushStrokeImage().clone();
-            cv::drawContours(combined, imageProcessor->getContours(), -1, cv::Scalar(255, 255, 255), 1);
-            renderer->renderImage(combined);
+        // Views are built once per result and stroke setting, and uploaded
+        // only when their version moves. Right after a load the worker has
+        // only published the original image; show it until the view's
+        // stages arrive.
+        int viewMode = static_cast<int>(renderer->getDisplayMode());
+        const unsigned needed = ImageProcessor::viewStages(viewMode);
+        if ((result.stages & needed) != needed) {
+            viewMode = 0;
         }
+        uint64_t version = 0;
+        const cv::Mat& view = viewCache->view(result, viewMode, &version);
+        renderer->renderImage(view, version);
 
         ImVec2 viewportSize = ImGui::GetContentRegionAvail();
-        ImGui::Image((ImTextureID)(intptr_t)renderer->getTextureID(), viewportSize, ImVec2(0, 1), ImVec2(1, 0));
+        ImGui::Image((ImTextureID)(intptr_t)renderer->getTextureID(), viewportSize);
 
         ImGui::End();
     }
@@ -457,13 +633,26 @@ void App::processFrame() {
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+void App::setDisplayMode(int mode) {
+    renderer->setDisplayMode(static_cast<Renderer::DisplayMode>(mode));
+    // Only compute what is on screen. Contours are always kept for the
+    // "Contours found" readout; they are cheap next to brush and neon.
+    worker->setOutputs(ImageProcessor::viewStages(mode) | ImageProcessor::STAGE_CONTOURS);
+}
+
 void App::handleInput() {
     // Handle keyboard input if needed
 }
 
+void App::setResultCache(const std::string& directory, uint64_t maxBytes) {
+    auto cache = std::make_unique<ResultCache>(directory, maxBytes);
+    if (cache->isOpen()) {
+        worker->setResultCache(std::move(cache));
+    }
+}
+
 void App::loadImage(const std::string& filepath) {
-    if (imageProcessor->loadImage(filepath)) {
-        imageProcessor->processImage();
+    if (worker->loadImage(filepath)) {
         std::cout << "Image loaded successfully: " << filepath << std::endl;
     } else {
         std::cerr << "Failed to load image: " << filepath << std::endl;
@@ -0,0 +1,240 @@
+#include "BatchProcessor.h"
+#include "BoundedQueue.h"
+#include "ResultCache.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Job {
+    fs::path input;
+    fs::path output;
+    cv::Mat image;              // Decoded input, then the rendered view
+    bool keyed = false;         // Has a cache key (the input could be hashed)
+    ResultCache::Key key;
+    ProcessingResult cached;    // Cache hit, used instead of image
+};
+
+std::string toLower(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return s;
+}
+
+bool isImageFile(const fs::path& path) {
+    const std::string ext = toLower(path.extension().string());
+    static const char* const known[] = {".png", ".jpg", ".jpeg", ".bmp", ".gif", ".tif", ".tiff", ".webp"};
+    return std::find(std::begin(known), std::end(known), ext) != std::end(known);
+}
+
+} // namespace
+
+BatchProcessor::BatchProcessor(const Options& options)
+    : options(options) {
+}
+
+int BatchProcessor::run() {
+    std::error_code ec;
+    if (!fs::is_directory(options.inputDir, ec)) {
+        std::cerr << "Input directory not found: " << options.inputDir << std::endl;
+        return -1;
+    }
+    fs::create_directories(options.outputDir, ec);
+    if (ec) {
+        std::cerr << "Failed to create output directory: " << options.outputDir << std::endl;
+        return -1;
+    }
+    // Outputs written next to the inputs would replace them, possibly while
+    // they are still being decoded
+    if (fs::equivalent(options.inputDir, options.outputDir, ec)) {
+        std::cerr << "Output directory must differ from the input directory: " << options.outputDir
+                  << std::endl;
+        return -1;
+    }
+
+    std::vector<fs::path> inputs;
+    for (const auto& entry : fs::directory_iterator(options.inputDir)) {
+        if (entry.is_regular_file() && isImageFile(entry.path())) {
+            inputs.push_back(entry.path());
+        }
+    }
+    std::sort(inputs.begin(), inputs.end());
+    if (inputs.empty()) {
+        std::cerr << "No images found in " << options.inputDir << std::endl;
+        return 0;
+    }
+
+    // Outputs are named <stem>.<ext>. Inputs that share a stem (a.jpg and
+    // a.png) keep their whole name instead (a.jpg.png, a.png.png), so no two
+    // encoder threads ever write the same file. Names are compared without
+    // case for case-insensitive file systems.
+    std::unordered_map<std::string, int> stemCounts;
+    for (const fs::path& input : inputs) {
+        stemCounts[toLower(input.stem().string())]++;
+    }
+    std::vector<fs::path> outputs;
+    std::unordered_set<std::string> outputNames;
+    outputs.reserve(inputs.size());
+    for (const fs::path& input : inputs) {
+        fs::path name = stemCounts[toLower(input.stem().string())] > 1 ? input.filename() : input.stem();
+        name += "." + options.extension;
+        if (!outputNames.insert(toLower(name.string())).second) {
+            std::cerr << "Two inputs would both be written to " << name.string() << std::endl;
+            return -1;
+        }
+        outputs.push_back(fs::path(options.outputDir) / name);
+    }
+
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const int processThreads = options.threads > 0 ? options.threads : static_cast<int>(cores);
+    const int decodeThreads = std::max(1, processThreads / 4);
+    const int encodeThreads = std::max(1, processThreads / 4);
+
+    // Parallelism comes from running many images at once; nested OpenCV
+    // threading inside each image would only oversubscribe the cores.
+    const int previousCvThreads = cv::getNumThreads();
+    cv::setNumThreads(1);
+
+    // Capacities bound the number of decoded images alive at any time
+    BoundedQueue<Job> decoded(static_cast<size_t>(processThreads) * 2);
+    BoundedQueue<Job> processed(static_cast<size_t>(encodeThreads) * 2);
+
+    std::unique_ptr<ResultCache> cache;
+    if (!options.cacheDir.empty()) {
+        cache = std::make_unique<ResultCache>(options.cacheDir, options.cacheSize);
+        if (!cache->isOpen()) {
+            cache.reset();
+        }
+    }
+    const unsigned stages = ImageProcessor::viewStages(options.displayMode);
+
+    std::atomic<size_t> nextInput{0};
+    std::atomic<int> written{0};
+    std::atomic<int> failed{0};
+    std::atomic<int> cacheHits{0};
+    std::mutex logMutex;
+    const auto start = std::chrono::steady_clock::now();
+
+    auto elapsedSeconds = [&start]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto decodeWorker = [&]() {
+        while (true) {
+            const size_t i = nextInput.fetch_add(1);
+            if (i >= inputs.size()) {
+                break;
+            }
+            Job job;
+            job.input = inputs[i];
+            job.output = outputs[i];
+            // A hit skips decoding, and processing too when it has every
+            // stage the view needs
+            uint64_t inputHash = 0;
+            if (cache && ResultCache::hashFile(inputs[i].string(), inputHash)) {
+                job.key = ResultCache::makeKey(inputHash, options.params);
+                job.keyed = true;
+                if (cache->load(job.key, job.cached)) {
+                    cacheHits++;
+                    if (!decoded.push(std::move(job))) {
+                        break;
+                    }
+                    continue;
+                }
+            }
+            job.image = ImageProcessor::decodeImage(inputs[i].string());
+            if (job.image.empty()) {
+                failed++;
+                continue;
+            }
+            if (!decoded.push(std::move(job))) {
+                break;
+            }
+        }
+    };
+
+    auto processWorker = [&]() {
+        // Each thread keeps its own processor; they are not thread-safe
+        ImageProcessor processor;
+        processor.setParams(options.params);
+        Job job;
+        while (decoded.pop(job)) {
+            // Cache hits that already hold every stage the view reads skip the processor
+            if (!job.cached.originalImage.empty() && (job.cached.stages & stages) == stages) {
+                job.image = ImageProcessor::composeView(job.cached, options.displayMode);
+            } else {
+                if (!job.cached.originalImage.empty()) {
+                    processor.setResult(std::move(job.cached));
+                } else {
+                    processor.setImage(job.image);
+                }
+                // Only the stages the requested view reads
+                processor.processStages(stages);
+                if (cache && job.keyed) {
+                    cache->store(job.key, processor.getResult());
+                }
+                job.image = ImageProcessor::composeView(processor.getResult(), options.displayMode);
+            }
+            job.cached = ProcessingResult();
+            if (!processed.push(std::move(job))) {
+                break;
+            }
+        }
+    };
+
+    auto encodeWorker = [&]() {
+        Job job;
+        while (processed.pop(job)) {
+            if (job.image.empty() || !ImageProcessor::writeImage(job.output.string(), job.image)) {
+                failed++;
+                continue;
+            }
+            const int done = ++written;
+            if (done % 100 == 0) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cout << "[batch] " << done << "/" << inputs.size() << " ("
+                          << done / std::max(elapsedSeconds(), 1e-6) << " images/sec)" << std::endl;
+            }
+        }
+    };
+
+    std::vector<std::thread> decoders, processors, encoders;
+    for (int i = 0; i < decodeThreads; ++i) decoders.emplace_back(decodeWorker);
+    for (int i = 0; i < processThreads; ++i) processors.emplace_back(processWorker);
+    for (int i = 0; i < encodeThreads; ++i) encoders.emplace_back(encodeWorker);
+
+    // Shut the stages down front to back so every queued job is drained
+    for (auto& t : decoders) t.join();
+    decoded.close();
+    for (auto& t : processors) t.join();
+    processed.close();
+    for (auto& t : encoders) t.join();
+
+    cv::setNumThreads(previousCvThreads);
+
+    const double seconds = elapsedSeconds();
+    std::cout << "[batch] Wrote " << written.load() << " of " << inputs.size() << " images in "
+              << seconds << " s (" << written.load() / std::max(seconds, 1e-6) << " images/sec, "
+              << decodeThreads << " decode / " << processThreads << " process / "
+              << encodeThreads << " encode threads)";
+    if (cache) {
+        std::cout << ", " << cacheHits.load() << " from cache";
+    }
+    if (failed.load() > 0) {
+        std::cout << ", " << failed.load() << " failed";
+    }
+    std::cout << std::endl;
+    return failed.load();
+}
@@ -0,0 +1,80 @@
+#include "ContourSet.h"
+#include <cmath>
+
+void ContourSet::clear() {
+    points.clear();
+    offsets.assign(1, 0);
+    info.clear();
+}
+
+void ContourSet::reserve(size_t contours, size_t pointCount) {
+    points.reserve(pointCount);
+    offsets.reserve(contours + 1);
+    info.reserve(contours);
+}
+
+void ContourSet::add(const std::vector<cv::Point>& contour) {
+    add(View(contour.data(), contour.size()), measure(contour));
+}
+
+void ContourSet::add(View contour, const Features& features) {
+    points.insert(points.end(), contour.begin(), contour.end());
+    offsets.push_back(points.size());
+    info.push_back(features);
+}
+
+ContourSet::Features ContourSet::measure(const std::vector<cv::Point>& contour) {
+    Features f;
+    if (!contour.empty()) {
+        f.area = cv::contourArea(contour);
+        f.length = cv::arcLength(contour, false);
+        f.bbox = cv::boundingRect(contour);
+
+        const cv::Moments m = cv::moments(contour);
+        if (std::fabs(m.m00) > 1e-5) {
+            f.centroid = cv::Point2f(static_cast<float>(m.m10 / m.m00), static_cast<float>(m.m01 / m.m00));
+        } else {
+            for (const auto& p : contour) {
+                f.centroid.x += static_cast<float>(p.x);
+                f.centroid.y += static_cast<float>(p.y);
+            }
+            f.centroid.x /= static_cast<float>(contour.size());
+            f.centroid.y /= static_cast<float>(contour.size());
+        }
+    }
+    return f;
+}
+
+void ContourSet::draw(cv::Mat& image, int index, const cv::Scalar& color, int thickness,
+                      int lineType, cv::Point offset) const {
+    const size_t first = index < 0 ? 0 : static_cast<size_t>(index);
+    const size_t last = index < 0 ? size() : first + 1;
+    if (first >= last || last > size()) {
+        return;
+    }
+
+    // Shifted copies only when an offset is asked for
+    std::vector<cv::Point> shifted;
+    const cv::Point* base = points.data() + offsets[first];
+    if (offset != cv::Point()) {
+        shifted.assign(points.begin() + offsets[first], points.begin() + offsets[last]);
+        for (cv::Point& p : shifted) {
+            p += offset;
+        }
+        base = shifted.data();
+    }
+
+    std::vector<const cv::Point*> starts;
+    std::vector<int> counts;
+    starts.reserve(last - first);
+    counts.reserve(last - first);
+    for (size_t i = first; i < last; ++i) {
+        if (offsets[i + 1] == offsets[i]) continue;
+        starts.push_back(base + (offsets[i] - offsets[first]));
+        counts.push_back(static_cast<int>(offsets[i + 1] - offsets[i]));
+    }
+    if (!starts.empty()) {
+        cv::polylines(image, starts.data(), counts.data(), static_cast<int>(starts.size()), true,
+                      color, thickness, lineType);
+    }
+}
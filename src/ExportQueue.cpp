@@ -0,0 +1,77 @@
+#include "ExportQueue.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Enough for a few "export all" batches in flight before push() waits
+constexpr size_t kQueueCapacity = 64;
+
+} // namespace
+
+ExportQueue::ExportQueue(int threads) : jobs(kQueueCapacity) {
+    for (int i = 0; i < std::max(1, threads); ++i) {
+        workers.emplace_back(&ExportQueue::run, this);
+    }
+}
+
+ExportQueue::~ExportQueue() {
+    jobs.close();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+bool ExportQueue::push(const std::string& path, const cv::Mat& image, const EncodeOptions& options) {
+    Job job;
+    job.path = path;
+    job.image = image;
+    job.options = options;
+
+    // Held across tryPush so a worker that finishes the job at once cannot
+    // count it done before it is counted in total
+    std::lock_guard<std::mutex> lock(progressMutex);
+    if (current.done == current.total) {
+        current = Progress();
+    }
+    if (!jobs.tryPush(std::move(job))) {
+        std::cerr << "Export queue is full, not saving: " << path << std::endl;
+        return false;
+    }
+    current.total++;
+    return true;
+}
+
+ExportQueue::Progress ExportQueue::progress() const {
+    std::lock_guard<std::mutex> lock(progressMutex);
+    return current;
+}
+
+void ExportQueue::run() {
+    Job job;
+    while (jobs.pop(job)) {
+        bool written = false;
+        try {
+            cv::Mat bgr = job.image;
+            if (job.image.channels() == 3) {
+                cv::cvtColor(job.image, bgr, cv::COLOR_RGB2BGR);
+            }
+            written = !bgr.empty() &&
+                      cv::imwrite(job.path, bgr, ImageProcessor::encoderParams(job.options));
+        } catch (const cv::Exception& e) {
+            std::cerr << "Failed to encode " << job.path << ": " << e.what() << std::endl;
+        }
+        if (written) {
+            std::cout << "Image saved successfully: " << job.path << std::endl;
+        } else {
+            std::cerr << "Failed to save image: " << job.path << std::endl;
+        }
+        job.image.release();
+
+        std::lock_guard<std::mutex> lock(progressMutex);
+        current.done++;
+        if (!written) {
+            current.failed++;
+        }
+    }
+}
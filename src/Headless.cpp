@@ -0,0 +1,166 @@
+#include "Headless.h"
+#include "BatchProcessor.h"
+#include "ImageProcessor.h"
+#include "TiledProcessor.h"
+#include "VideoProcessor.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// Same order as Renderer::DisplayMode and ImageProcessor::composeView
+const char* const kModeNames[] = {"original", "edges", "contours", "brush", "combined", "neon"};
+
+int parseMode(const std::string& name) {
+    for (int i = 0; i < 6; ++i) {
+        if (name == kModeNames[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  " << program << " --batch <in_dir> <out_dir> [options]\n"
+              << "  " << program << " --video <in_file> <out_file> [options]\n"
+              << "  " << program << " --tiled <in_file> <out_file> [options]\n"
+              << "\n"
+              << "Options:\n"
+              << "  --mode <name>      original, edges, contours, brush, combined, neon (default: neon)\n"
+              << "  --params <file>    Parameter preset (.json or .yml)\n"
+              << "  --threads <n>      Process threads (default: one per core)\n"
+              << "  --seed <n>         Brush stroke seed (overrides the preset)\n"
+              << "  --ext <format>     Batch output format, e.g. png, jpg, webp (default: png)\n"
+              << "  --cache <dir>      Batch: reuse results stored in dir from earlier runs\n"
+              << "  --cache-size <MB>  Batch: size limit of the cache (default: 2048)\n"
+              << "  --fourcc <code>    Video codec, e.g. mp4v, MJPG (default: from extension)\n"
+              << "  --temporal         Video: reuse work between frames (runs frames in order)\n"
+              << "  --tile <px>        Tiled: tile size before the halo (default: 1024)\n"
+              << "  --scratch <dir>    Tiled: directory for scratch files (default: system temp)\n";
+}
+
+// Options shared by every headless mode
+struct CommonOptions {
+    int displayMode = 5;
+    int threads = 0;
+    std::string extension = "png";
+    std::string fourcc;
+    bool temporal = false;
+    int tileSize = 1024;
+    std::string scratchDir;
+    std::string cacheDir;
+    int cacheSizeMB = 2048;
+    ImageProcessor::Params params;
+};
+
+bool parseOptions(int argc, char* argv[], int first, CommonOptions& options) {
+    // Applied last so it overrides --params wherever it appears
+    std::string seed;
+    for (int i = first; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--temporal") {
+            options.temporal = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const std::string value = argv[++i];
+        if (arg == "--mode") {
+            options.displayMode = parseMode(value);
+            if (options.displayMode < 0) {
+                std::cerr << "Unknown mode: " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--params") {
+            if (!ImageProcessor::loadParams(value, options.params)) {
+                return false;
+            }
+        } else if (arg == "--seed") {
+            seed = value;
+        } else if (arg == "--threads") {
+            options.threads = std::atoi(value.c_str());
+        } else if (arg == "--ext") {
+            options.extension = value;
+        } else if (arg == "--fourcc") {
+            options.fourcc = value;
+        } else if (arg == "--tile") {
+            options.tileSize = std::atoi(value.c_str());
+        } else if (arg == "--scratch") {
+            options.scratchDir = value;
+        } else if (arg == "--cache") {
+            options.cacheDir = value;
+        } else if (arg == "--cache-size") {
+            options.cacheSizeMB = std::atoi(value.c_str());
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    if (!seed.empty()) {
+        options.params.seed = std::atoi(seed.c_str());
+    }
+    return true;
+}
+
+} // namespace
+
+bool isHeadlessCommand(const char* arg) {
+    return arg && (std::strcmp(arg, "--batch") == 0 || std::strcmp(arg, "--video") == 0 ||
+                   std::strcmp(arg, "--tiled") == 0);
+}
+
+int runHeadless(int argc, char* argv[]) {
+    CommonOptions common;
+    if (argc < 4 || !isHeadlessCommand(argv[1]) || !parseOptions(argc, argv, 4, common)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (std::strcmp(argv[1], "--video") == 0) {
+        VideoProcessor::Options options;
+        options.inputPath = argv[2];
+        options.outputPath = argv[3];
+        options.fourcc = common.fourcc;
+        options.displayMode = common.displayMode;
+        options.threads = common.threads;
+        options.temporal = common.temporal;
+        options.params = common.params;
+
+        VideoProcessor video(options);
+        return video.run() ? 0 : 1;
+    }
+
+    if (std::strcmp(argv[1], "--tiled") == 0) {
+        TiledProcessor::Options options;
+        options.inputPath = argv[2];
+        options.outputPath = argv[3];
+        options.scratchDir = common.scratchDir;
+        options.displayMode = common.displayMode;
+        options.tileSize = common.tileSize;
+        options.threads = common.threads;
+        options.params = common.params;
+
+        TiledProcessor tiled(options);
+        return tiled.run() ? 0 : 1;
+    }
+
+    BatchProcessor::Options options;
+    options.inputDir = argv[2];
+    options.outputDir = argv[3];
+    options.extension = common.extension;
+    options.displayMode = common.displayMode;
+    options.threads = common.threads;
+    options.cacheDir = common.cacheDir;
+    options.cacheSize = static_cast<uint64_t>(std::max(common.cacheSizeMB, 1)) << 20;
+    options.params = common.params;
+
+    BatchProcessor batch(options);
+    return batch.run() == 0 ? 0 : 1;
+}
@@ -1,11 +1,128 @@
 #include "ImageProcessor.h"
+#include "CounterRng.h"
+#include "MappedFile.h"
+#include "NeonGlow.h"
 #include <opencv2/ximgproc.hpp>
 #include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <random>
+#include <limits>
+#include <sstream>
 #include <unordered_map>
 
+namespace {
+
+// Longest side of images loaded for the GUI, batch and video modes
+constexpr int kMaxImageDim = 1024;
+
+// Width and height from a JPEG's frame header, without decoding anything
+bool jpegSize(const uint8_t* data, size_t size, int& width, int& height) {
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) return false;
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {                   // Fill byte
+            pos++;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;                           // Markers without a length
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) {
+            return false;                       // End of image or scan data before a frame header
+        }
+        const size_t length = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+        // SOF0-SOF15, except DHT (C4), JPG (C8) and DAC (CC) which share the range
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            if (pos + 9 > size) return false;
+            height = (data[pos + 5] << 8) | data[pos + 6];
+            width = (data[pos + 7] << 8) | data[pos + 8];
+            return width > 0 && height > 0;
+        }
+        if (length < 2) return false;
+        pos += 2 + length;
+    }
+    return false;
+}
+
+// Largest libjpeg DCT scaling (1/2, 1/4, 1/8) that still leaves the image
+// at least kMaxImageDim on its long side, so the final resize still only
+// shrinks it
+int reducedJpegFlag(int width, int height) {
+    const int longest = std::max(width, height);
+    if (longest >= kMaxImageDim * 8) return cv::IMREAD_REDUCED_COLOR_8;
+    if (longest >= kMaxImageDim * 4) return cv::IMREAD_REDUCED_COLOR_4;
+    if (longest >= kMaxImageDim * 2) return cv::IMREAD_REDUCED_COLOR_2;
+    return cv::IMREAD_COLOR;
+}
+
+// Key of the square grid cell (of the given size) that holds p
+uint64_t gridCellKey(const cv::Point2f& p, float cellSize) {
+    const auto cx = static_cast<uint32_t>(static_cast<int32_t>(std::floor(p.x / cellSize)));
+    const auto cy = static_cast<uint32_t>(static_cast<int32_t>(std::floor(p.y / cellSize)));
+    return (static_cast<uint64_t>(cy) << 32) | cx;
+}
+
+// Group points linked by chains of neighbours closer than radius (DBSCAN
+// with a minimum of one point). Points are bucketed on a grid with cells as
+// large as the radius, so each point only tests the 3x3 cells around it, and
+// linked points are merged with union-find. Returns each point's group as
+// the smallest index in it, which does not depend on hash iteration order.
+std::vector<int> groupByRadius(const std::vector<cv::Point2f>& points, float radius) {
+    const int n = static_cast<int>(points.size());
+    std::vector<int> parent(n);
+    for (int i = 0; i < n; ++i) {
+        parent[i] = i;
+    }
+    if (radius <= 0.0f) {
+        return parent;
+    }
+
+    auto find = [&parent](int i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];  // Path halving
+            i = parent[i];
+        }
+        return i;
+    };
+
+    std::unordered_map<uint64_t, std::vector<int>> grid;
+    grid.reserve(points.size());
+    const float radius2 = radius * radius;
+    for (int i = 0; i < n; ++i) {
+        // Link to earlier points only; each pair is tested once
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                const cv::Point2f probe(points[i].x + dx * radius, points[i].y + dy * radius);
+                auto it = grid.find(gridCellKey(probe, radius));
+                if (it == grid.end()) continue;
+                for (int j : it->second) {
+                    const float ex = points[i].x - points[j].x;
+                    const float ey = points[i].y - points[j].y;
+                    if (ex * ex + ey * ey > radius2) continue;
+                    const int a = find(i);
+                    const int b = find(j);
+                    if (a != b) {
+                        parent[std::max(a, b)] = std::min(a, b);
+                    }
+                }
+            }
+        }
+        grid[gridCellKey(points[i], radius)].push_back(i);
+    }
+
+    for (int i = 0; i < n; ++i) {
+        parent[i] = find(i);
+    }
+    return parent;
+}
+
+} // namespace
+
 ImageProcessor::ImageProcessor() {
 }
 
@@ -13,229 +130,928 @@ ImageProcessor::~ImageProcessor() {
 }
 
 bool ImageProcessor::loadImage(const std::string& filepath) {
-    originalImage = cv::imread(filepath);
-    if (originalImage.empty()) {
-        std::cerr << "Failed to load image: " << filepath << std::endl;
+    cv::Mat image = decodeImage(filepath);
+    if (image.empty()) {
         return false;
     }
+    setImage(image);
+    return true;
+}
+
+cv::Mat ImageProcessor::decodeImage(const std::string& filepath) {
+    // Decode in place from a read-only mapping of the file instead of
+    // reading it into a buffer first
+    MappedFile file;
+    cv::Mat image;
+    if (file.openRead(filepath) && file.size() <= static_cast<size_t>(std::numeric_limits<int>::max())) {
+        const cv::Mat bytes(1, static_cast<int>(file.size()), CV_8UC1, file.data());
+
+        // Large JPEGs only need to be decoded at a fraction of their size
+        int width = 0;
+        int height = 0;
+        const int flags = jpegSize(file.data(), file.size(), width, height)
+                              ? reducedJpegFlag(width, height)
+                              : cv::IMREAD_COLOR;
+        image = cv::imdecode(bytes, flags);
+        if (!image.empty() && flags != cv::IMREAD_COLOR) {
+            // The header size is before EXIF rotation
+            if ((image.cols > image.rows) != (width > height)) {
+                std::swap(width, height);
+            }
+            return prepareImage(image, cv::Size(width, height));
+        }
+    }
+    if (image.empty()) {
+        std::cerr << "Failed to load image: " << filepath << std::endl;
+        return image;
+    }
+    return prepareImage(image);
+}
+
+cv::Mat ImageProcessor::prepareImage(const cv::Mat& bgrImage, cv::Size sourceSize) {
+    if (sourceSize.empty()) {
+        sourceSize = bgrImage.size();
+    }
+
+    // Limit image size for performance. The resize comes first so the
+    // channel swap only touches the pixels that are kept.
+    cv::Mat image = bgrImage;
+    if (sourceSize.width > kMaxImageDim || sourceSize.height > kMaxImageDim) {
+        float scale = static_cast<float>(kMaxImageDim) / std::max(sourceSize.width, sourceSize.height);
+        if (sourceSize == bgrImage.size()) {
+            cv::resize(bgrImage, image, cv::Size(), scale, scale, cv::INTER_AREA);
+        } else {
+            // Decoded reduced: aim for the size the full image would get
+            const cv::Size target(cv::saturate_cast<int>(sourceSize.width * static_cast<double>(scale)),
+                                  cv::saturate_cast<int>(sourceSize.height * static_cast<double>(scale)));
+            cv::resize(bgrImage, image, target, 0, 0, cv::INTER_AREA);
+        }
+    }
 
     // Convert to RGB if BGR
-    if (originalImage.channels() == 3) {
-        cv::cvtColor(originalImage, originalImage, cv::COLOR_BGR2RGB);
+    cv::Mat rgb;
+    if (image.channels() == 3) {
+        cv::cvtColor(image, rgb, cv::COLOR_BGR2RGB);
+    } else if (image.data == bgrImage.data) {
+        rgb = image.clone();
+    } else {
+        rgb = image;
     }
+    return rgb;
+}
 
-    // Limit image size for performance
-    const int maxDim = 1024;
-    if (originalImage.cols > maxDim || originalImage.rows > maxDim) {
-        float scale = static_cast<float>(maxDim) / std::max(originalImage.cols, originalImage.rows);
-        cv::resize(originalImage, originalImage, cv::Size(), scale, scale, cv::INTER_AREA);
+void ImageProcessor::setImage(const cv::Mat& image) {
+    // The previous gradient task still reads the old gray image
+    if (features.gradients.valid()) {
+        features.gradients.get();
     }
 
-    processedImage = originalImage.clone();
-    return true;
+    result.originalImage = image;
+    processedImage = image.clone();
+
+    if (image.channels() == 3) {
+        cv::cvtColor(image, features.gray, cv::COLOR_RGB2GRAY);
+    } else {
+        features.gray = image.clone();
+    }
+    features.hasGradients = false;
+
+    edgeCache.valid = false;
+    dirtyStages = STAGE_ALL;
+}
+
+void ImageProcessor::setResult(ProcessingResult cached) {
+    setImage(cached.originalImage);
+
+    result.edgeImage = std::move(cached.edgeImage);
+    result.brushStrokeImage = std::move(cached.brushStrokeImage);
+    result.neonImage = std::move(cached.neonImage);
+    result.contours = std::move(cached.contours);
+    result.generation++;
+    result.scale = 1.0f;
+
+    // None of the intermediates behind the cached stages exist; each is
+    // rebuilt from the outputs (or recomputed) when a later run needs it
+    contourCache.valid = false;
+    contourIds.clear();
+    neonLayers = NeonLayers();
+
+    dirtyStages = STAGE_ALL & ~cached.stages;
+    result.stages = STAGE_ALL & ~dirtyStages;
+}
+
+void ImageProcessor::computeGradients() {
+    cv::Sobel(features.gray, features.gradX, CV_16S, 1, 0, 3);
+    cv::Sobel(features.gray, features.gradY, CV_16S, 0, 1, 3);
+}
+
+const ImageProcessor::ImageFeatures& ImageProcessor::imageFeatures() {
+    if (features.gradients.valid()) {
+        features.gradients.get();
+        features.hasGradients = true;
+    } else if (!features.hasGradients) {
+        computeGradients();
+        features.hasGradients = true;
+    }
+    return features;
 }
 
 bool ImageProcessor::saveImage(const std::string& filepath, int displayMode) const {
-    cv::Mat imageToSave;
-    
+    return saveImage(result, filepath, displayMode);
+}
+
+bool ImageProcessor::saveImage(const ProcessingResult& result, const std::string& filepath, int displayMode) {
+    cv::Mat imageToSave = composeView(result, displayMode);
+    if (imageToSave.empty()) {
+        std::cerr << "No image to save" << std::endl;
+        return false;
+    }
+    return writeImage(filepath, imageToSave);
+}
+
+cv::Mat ImageProcessor::composeView(const ProcessingResult& result, int displayMode) {
+    cv::Mat view;
+
     // Select the appropriate image based on display mode
     // 0: Original, 1: Edges, 2: Contours, 3: Brush Strokes, 4: Combined, 5: Neon
     switch (displayMode) {
         case 0: // Original
-            imageToSave = originalImage.clone();
+            view = result.originalImage.clone();
             break;
         case 1: // Edges
-            cv::cvtColor(edgeImage, imageToSave, cv::COLOR_GRAY2BGR);
+            if (!result.edgeImage.empty()) {
+                cv::cvtColor(result.edgeImage, view, cv::COLOR_GRAY2RGB);
+            }
             break;
         case 2: // Contours
-            imageToSave = originalImage.clone();
-            cv::drawContours(imageToSave, contours, -1, cv::Scalar(255, 255, 255), 2);
+            view = result.originalImage.clone();
+            if (!view.empty()) {
+                result.contours.draw(view, -1, cv::Scalar(255, 255, 255), 2);
+            }
             break;
         case 3: // Brush Strokes
-            imageToSave = brushStrokeImage.clone();
+            view = result.brushStrokeImage.clone();
             break;
         case 4: // Combined
-            imageToSave = brushStrokeImage.clone();
-            cv::drawContours(imageToSave, contours, -1, cv::Scalar(255, 255, 255), 1);
+            view = result.brushStrokeImage.clone();
+            if (!view.empty()) {
+                result.contours.draw(view, -1, cv::Scalar(255, 255, 255), 1);
+            }
             break;
         case 5: // Neon
-            imageToSave = neonImage.clone();
+            view = result.neonImage.clone();
             break;
         default:
-            imageToSave = brushStrokeImage.clone();
+            view = result.brushStrokeImage.clone();
             break;
     }
-    
-    if (imageToSave.empty()) {
-        std::cerr << "No image to save" << std::endl;
-        return false;
+    return view;
+}
+
+unsigned ImageProcessor::viewStages(int displayMode) {
+    switch (displayMode) {
+        case 0: return 0;                                   // Original
+        case 1: return STAGE_EDGES;                         // Edges
+        case 2: return STAGE_CONTOURS;                      // Contours
+        case 3: return STAGE_BRUSH;                         // Brush Strokes
+        case 4: return STAGE_BRUSH | STAGE_CONTOURS;        // Combined
+        case 5: return STAGE_NEON_COMPOSITE;                // Neon
+        default: return STAGE_BRUSH;                        // composeView's fallback
     }
-    
+}
+
+std::vector<int> ImageProcessor::encoderParams(const EncodeOptions& options) {
+    // WebP quality above 100 selects lossless encoding
+    return {
+        cv::IMWRITE_PNG_COMPRESSION, std::clamp(options.pngCompression, 0, 9),
+        cv::IMWRITE_JPEG_QUALITY, std::clamp(options.jpegQuality, 0, 100),
+        cv::IMWRITE_WEBP_QUALITY, options.webpLossless ? 101 : std::clamp(options.webpQuality, 1, 100),
+    };
+}
+
+bool ImageProcessor::writeImage(const std::string& filepath, const cv::Mat& image, const EncodeOptions& options) {
     // Convert RGB to BGR for OpenCV saving
-    if (imageToSave.channels() == 3) {
-        cv::cvtColor(imageToSave, imageToSave, cv::COLOR_RGB2BGR);
+    cv::Mat imageToSave = image;
+    if (image.channels() == 3) {
+        cv::cvtColor(image, imageToSave, cv::COLOR_RGB2BGR);
     }
-    
+
     // Save the image
-    bool success = cv::imwrite(filepath, imageToSave);
+    bool success = cv::imwrite(filepath, imageToSave, encoderParams(options));
     if (!success) {
         std::cerr << "Failed to write image to: " << filepath << std::endl;
     }
     return success;
 }
 
-void ImageProcessor::processImage() {
-    if (originalImage.empty()) {
-        return;
+namespace {
+
+// Visits every preset field by name. Shared by loadParams and saveParams so
+// the two can never disagree on the key list.
+template <typename ParamsT, typename Visitor>
+void visitParams(ParamsT& p, Visitor&& visit) {
+    visit("cannyThreshold1", p.cannyThreshold1);
+    visit("cannyThreshold2", p.cannyThreshold2);
+    visit("contourMinArea", p.contourMinArea);
+    visit("brushSize", p.brushSize);
+    visit("brushDensity", p.brushDensity);
+    visit("brushBackend", p.brushBackend);
+    visit("seed", p.seed);
+    visit("edgeDensityKernel", p.edgeDensityKernel);
+    visit("blurStrength", p.blurStrength);
+    visit("useBilateralFilter", p.useBilateralFilter);
+    visit("bilateralD", p.bilateralD);
+    visit("bilateralSigmaColor", p.bilateralSigmaColor);
+    visit("bilateralSigmaSpace", p.bilateralSigmaSpace);
+    visit("morphologySize", p.morphologySize);
+    visit("minContourLength", p.minContourLength);
+    visit("edgeDilation", p.edgeDilation);
+    visit("edgeSmoothing", p.edgeSmoothing);
+    visit("contourSmoothing", p.contourSmoothing);
+    visit("neonCenterColor", p.neonCenterColor);
+    visit("neonOtherColor", p.neonOtherColor);
+    visit("neonEdgeColor", p.neonEdgeColor);
+    visit("neonGlowStrength", p.neonGlowStrength);
+    visit("neonGlowSize", p.neonGlowSize);
+    visit("neonGlowBackend", p.neonGlowBackend);
+    visit("neonMaxObjects", p.neonMaxObjects);
+    visit("neonMinObjectAreaRatio", p.neonMinObjectAreaRatio);
+    visit("neonJoinSize", p.neonJoinSize);
+    visit("neonPerContour", p.neonPerContour);
+    visit("neonKMeansEnabled", p.neonKMeansEnabled);
+    visit("neonKMeansK", p.neonKMeansK);
+    visit("neonKMeansNearDistancePx", p.neonKMeansNearDistancePx);
+    visit("neonGroupingBackend", p.neonGroupingBackend);
+}
+
+template <typename T>
+void readParam(const cv::FileNode& node, T& value) {
+    if (!node.empty()) {
+        node >> value;
     }
+}
 
-    detectEdges();
-    findContours();
-    createBrushStrokes();
-    createNeonEffect();
+void readParam(const cv::FileNode& node, bool& value) {
+    if (!node.empty()) {
+        value = static_cast<int>(node) != 0;
+    }
 }
 
-void ImageProcessor::detectEdges() {
-    cv::Mat gray;
-    if (originalImage.channels() == 3) {
-        cv::cvtColor(originalImage, gray, cv::COLOR_RGB2GRAY);
-    } else {
-        gray = originalImage.clone();
+// Presets store colors as [r, g, b]; Params keeps them in BGR order
+void readParam(const cv::FileNode& node, cv::Scalar& bgr) {
+    if (node.isSeq() && node.size() >= 3) {
+        bgr = cv::Scalar(static_cast<double>(node[2]), static_cast<double>(node[1]), static_cast<double>(node[0]));
+    }
+}
+
+template <typename T>
+void writeParam(cv::FileStorage& fs, const char* key, const T& value) {
+    fs << key << value;
+}
+
+void writeParam(cv::FileStorage& fs, const char* key, bool value) {
+    fs << key << static_cast<int>(value);
+}
+
+void writeParam(cv::FileStorage& fs, const char* key, const cv::Scalar& bgr) {
+    fs << key << "[" << bgr[2] << bgr[1] << bgr[0] << "]";
+}
+
+template <typename T>
+void writeValue(std::ostream& out, const T& value) {
+    out << value;
+}
+
+void writeValue(std::ostream& out, const cv::Scalar& value) {
+    out << value[0] << ',' << value[1] << ',' << value[2] << ',' << value[3];
+}
+
+} // namespace
+
+bool ImageProcessor::loadParams(const std::string& filepath, Params& params) {
+    try {
+        cv::FileStorage fs(filepath, cv::FileStorage::READ);
+        if (!fs.isOpened()) {
+            std::cerr << "Failed to open preset: " << filepath << std::endl;
+            return false;
+        }
+        visitParams(params, [&fs](const char* key, auto& value) {
+            readParam(fs[key], value);
+        });
+    } catch (const cv::Exception& e) {
+        std::cerr << "Failed to parse preset " << filepath << ": " << e.what() << std::endl;
+        return false;
     }
+    return true;
+}
+
+bool ImageProcessor::saveParams(const std::string& filepath, const Params& params) {
+    try {
+        cv::FileStorage fs(filepath, cv::FileStorage::WRITE);
+        if (!fs.isOpened()) {
+            std::cerr << "Failed to write preset: " << filepath << std::endl;
+            return false;
+        }
+        visitParams(params, [&fs](const char* key, const auto& value) {
+            writeParam(fs, key, value);
+        });
+    } catch (const cv::Exception& e) {
+        std::cerr << "Failed to write preset " << filepath << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string ImageProcessor::serializeParams(const Params& params) {
+    std::ostringstream out;
+    out.precision(17);
+    visitParams(params, [&out](const char* key, const auto& value) {
+        out << key << '=';
+        writeValue(out, value);
+        out << ';';
+    });
+    return out.str();
+}
+
+bool ImageProcessor::processImage(const std::atomic<bool>* cancel) {
+    return processStages(STAGE_ALL, cancel);
+}
+
+bool ImageProcessor::processStages(unsigned stages, const std::atomic<bool>* cancel) {
+    if (result.originalImage.empty()) {
+        return true;
+    }
+
+    // Pull in upstream dependencies
+    unsigned needed = stages;
+    if (needed & STAGE_NEON_COMPOSITE) needed |= STAGE_NEON;
+    if (needed & (STAGE_BRUSH | STAGE_NEON)) needed |= STAGE_CONTOURS;
+    if (needed & STAGE_CONTOURS) needed |= STAGE_EDGES;
+
+    auto cancelled = [cancel]() {
+        return cancel && cancel->load(std::memory_order_relaxed);
+    };
+
+    // Only runs that draw brush strokes need the gradients
+    if ((dirtyStages & needed & STAGE_BRUSH) && asyncGradients && !features.hasGradients &&
+        !features.gradients.valid()) {
+        features.gradients = std::async(std::launch::async, [this]() { computeGradients(); });
+    }
+
+    // Each stage clears its own bit once its output is up to date, so the
+    // cached intermediates of clean stages are reused as-is.
+    const unsigned before = dirtyStages;
+    unsigned run = dirtyStages & needed;
+    // After setResult() the neon output is current but its layers are not
+    // kept, so recoloring them has to make them first
+    if ((run & STAGE_NEON_COMPOSITE) && neonLayers.edgeMask.empty()) {
+        run |= STAGE_NEON;
+    }
+    if (run & STAGE_EDGES) {
+        detectEdges();
+        dirtyStages &= ~STAGE_EDGES;
+    }
+    if ((run & STAGE_CONTOURS) && !cancelled()) {
+        findContours();
+        dirtyStages &= ~STAGE_CONTOURS;
+    }
+    if ((run & STAGE_BRUSH) && !cancelled()) {
+        createBrushStrokes();
+        dirtyStages &= ~STAGE_BRUSH;
+    }
+    if ((run & STAGE_NEON) && !cancelled()) {
+        createNeonEffect();
+        dirtyStages &= ~STAGE_NEON;
+    }
+    if ((run & STAGE_NEON_COMPOSITE) && !cancelled()) {
+        compositeNeon();
+        dirtyStages &= ~STAGE_NEON_COMPOSITE;
+    }
+
+    if (dirtyStages != before) {
+        result.generation++;
+    }
+    result.stages = STAGE_ALL & ~dirtyStages;
+    return (dirtyStages & needed) == 0;
+}
+
+void ImageProcessor::setParams(const Params& p) {
+    setCannyThreshold1(p.cannyThreshold1);
+    setCannyThreshold2(p.cannyThreshold2);
+    setContourMinArea(p.contourMinArea);
+    setBrushSize(p.brushSize);
+    setBrushDensity(p.brushDensity);
+    setBrushBackend(p.brushBackend);
+    setSeed(p.seed);
+    setEdgeDensityKernel(p.edgeDensityKernel);
+    setBlurStrength(p.blurStrength);
+    setBilateralFilter(p.useBilateralFilter);
+    setBilateralD(p.bilateralD);
+    setBilateralSigmaColor(p.bilateralSigmaColor);
+    setBilateralSigmaSpace(p.bilateralSigmaSpace);
+    setMorphologySize(p.morphologySize);
+    setMinContourLength(p.minContourLength);
+    setEdgeDilation(p.edgeDilation);
+    setEdgeSmoothing(p.edgeSmoothing);
+    setContourSmoothing(p.contourSmoothing);
+
+    setParam(params.neonCenterColor, p.neonCenterColor, STAGE_NEON);
+    setParam(params.neonOtherColor, p.neonOtherColor, STAGE_NEON);
+    setParam(params.neonEdgeColor, p.neonEdgeColor, STAGE_NEON_COMPOSITE);
+    setNeonGlowStrength(p.neonGlowStrength);
+    setNeonGlowSize(p.neonGlowSize);
+    setNeonGlowBackend(p.neonGlowBackend);
+    setNeonMaxObjects(p.neonMaxObjects);
+    setNeonMinObjectAreaRatio(p.neonMinObjectAreaRatio);
+    setNeonJoinSize(p.neonJoinSize);
+    setNeonPerContour(p.neonPerContour);
+    setNeonKMeansEnabled(p.neonKMeansEnabled);
+    setNeonKMeansK(p.neonKMeansK);
+    setNeonKMeansNearDistancePx(p.neonKMeansNearDistancePx);
+    setNeonGroupingBackend(p.neonGroupingBackend);
+}
+
+ImageProcessor::Params ImageProcessor::scaleParams(const Params& p, double scale) {
+    auto size = [scale](int val, int minVal) {
+        return std::max(minVal, static_cast<int>(std::lround(val * scale)));
+    };
+    // Kernel sizes of 0 mean "disabled" and must stay that way
+    auto optionalSize = [&size](int val) {
+        return val > 0 ? size(val, 1) : 0;
+    };
+
+    Params s = p;
+    s.contourMinArea = p.contourMinArea * scale * scale;
+    s.minContourLength = p.minContourLength * scale;
+    s.brushSize = size(p.brushSize, 1);
+    s.edgeDensityKernel = size(p.edgeDensityKernel, 3) | 1;  // Odd, so it stays centered
+    s.blurStrength = size(p.blurStrength, 1);
+    s.bilateralD = size(p.bilateralD, 1);
+    s.bilateralSigmaSpace = p.bilateralSigmaSpace * scale;
+    s.morphologySize = optionalSize(p.morphologySize);
+    s.edgeDilation = optionalSize(p.edgeDilation);
+    s.edgeSmoothing = optionalSize(p.edgeSmoothing);
+    s.contourSmoothing = p.contourSmoothing * scale;
+    s.neonGlowSize = size(p.neonGlowSize, 1);
+    s.neonJoinSize = size(p.neonJoinSize, 3);
+    s.neonKMeansNearDistancePx = static_cast<float>(p.neonKMeansNearDistancePx * scale);
+    return s;
+}
+
+void ImageProcessor::setTemporalCoherence(bool enabled) {
+    if (temporalCoherence == enabled) return;
+    temporalCoherence = enabled;
+    resetTemporalState();
+    // Contours need track ids, and brush/neon switch RNG and coloring
+    invalidate(STAGE_CONTOURS);
+}
 
-    // Apply noise reduction
-    cv::Mat blurred;
-    if (useBilateralFilter) {
-        // Bilateral filter - edge-preserving blur
-        cv::bilateralFilter(gray, blurred, bilateralD, bilateralSigmaColor, bilateralSigmaSpace);
+void ImageProcessor::resetTemporalState() {
+    temporal = TemporalState();
+    contourIds.clear();
+}
+
+void ImageProcessor::setTileContext(const TileContext& context) {
+    const bool newEdges = !context.cannyEdges.empty() || !tileContext.cannyEdges.empty();
+    tileContext = context;
+    invalidate(newEdges ? STAGE_EDGES : STAGE_CONTOURS);
+}
+
+void ImageProcessor::invalidate(Stage stage) {
+    switch (stage) {
+        case STAGE_EDGES:
+            dirtyStages |= STAGE_ALL;
+            break;
+        case STAGE_CONTOURS:
+            dirtyStages |= STAGE_CONTOURS | STAGE_BRUSH | STAGE_NEON | STAGE_NEON_COMPOSITE;
+            break;
+        case STAGE_NEON:
+            dirtyStages |= STAGE_NEON | STAGE_NEON_COMPOSITE;
+            break;
+        default:
+            dirtyStages |= stage;
+            break;
+    }
+}
+
+std::vector<int> ImageProcessor::groupContourColors(const std::vector<cv::Point2f>& centroids,
+                                                   const std::vector<int>& ids, const Params& params) {
+    const int n = static_cast<int>(centroids.size());
+    std::vector<int> colors(ids.begin(), ids.end());
+    if (!params.neonKMeansEnabled || n < 2) {
+        return colors;
+    }
+
+    if (params.neonGroupingBackend == GROUPING_GRID) {
+        // Same as createNeonEffect(): a group takes its smallest id
+        const std::vector<int> group = groupByRadius(centroids, params.neonKMeansNearDistancePx);
+        std::vector<int> groupColor(n, -1);
+        for (int i = 0; i < n; ++i) {
+            int& color = groupColor[group[i]];
+            color = color < 0 ? ids[i] : std::min(color, ids[i]);
+        }
+        for (int i = 0; i < n; ++i) {
+            colors[i] = groupColor[group[i]];
+        }
+        return colors;
+    }
+
+    const int k = std::clamp(params.neonKMeansK, 1, n);
+    cv::Mat samples(n, 2, CV_32F);
+    for (int i = 0; i < n; ++i) {
+        samples.at<float>(i, 0) = centroids[i].x;
+        samples.at<float>(i, 1) = centroids[i].y;
+    }
+    cv::Mat labels;
+    cv::Mat centers;
+    const cv::TermCriteria criteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 20, 1.0);
+    cv::kmeans(samples, k, labels, criteria, 3, cv::KMEANS_PP_CENTERS, centers);
+
+    // Members far from their center keep a color of their own
+    const float nearPx = std::max(0.0f, params.neonKMeansNearDistancePx);
+    for (int i = 0; i < n; ++i) {
+        const int lbl = labels.at<int>(i, 0);
+        const float dx = centroids[i].x - centers.at<float>(lbl, 0);
+        const float dy = centroids[i].y - centers.at<float>(lbl, 1);
+        colors[i] = nearPx > 0.0f && dx * dx + dy * dy > nearPx * nearPx ? k + ids[i] : lbl;
+    }
+    return colors;
+}
+
+void ImageProcessor::classifyEdgePixels(cv::Mat& out) {
+    prepareEdges();
+    edgeCache.canny.classify(params.cannyThreshold1, params.cannyThreshold2, out);
+}
+
+void ImageProcessor::prepareEdges() {
+    // Blur, gradients and non-maximum suppression only depend on the image
+    // and the noise reduction settings
+    EdgeCache& cache = edgeCache;
+    const bool sameBlur = cache.valid &&
+        cache.useBilateralFilter == params.useBilateralFilter &&
+        (params.useBilateralFilter
+             ? cache.bilateralD == params.bilateralD &&
+               cache.bilateralSigmaColor == params.bilateralSigmaColor &&
+               cache.bilateralSigmaSpace == params.bilateralSigmaSpace
+             : cache.blurStrength == params.blurStrength);
+    if (!sameBlur) {
+        const cv::Mat& gray = features.gray;
+
+        // Apply noise reduction
+        cv::Mat blurred;
+        if (params.useBilateralFilter) {
+            // Bilateral filter - edge-preserving blur
+            cv::bilateralFilter(gray, blurred, params.bilateralD, params.bilateralSigmaColor, params.bilateralSigmaSpace);
+        } else {
+            // Gaussian blur - ensure kernel size is odd and >= 1
+            int kernelSize = std::max(1, params.blurStrength);
+            if (kernelSize % 2 == 0) kernelSize++;
+            cv::GaussianBlur(gray, blurred, cv::Size(kernelSize, kernelSize), 0);
+        }
+
+        cache.canny.prepare(blurred);
+        cache.useBilateralFilter = params.useBilateralFilter;
+        cache.blurStrength = params.blurStrength;
+        cache.bilateralD = params.bilateralD;
+        cache.bilateralSigmaColor = params.bilateralSigmaColor;
+        cache.bilateralSigmaSpace = params.bilateralSigmaSpace;
+        cache.valid = true;
+    }
+}
+
+void ImageProcessor::detectEdges() {
+    // New edges, new contours
+    contourCache.valid = false;
+
+    if (!tileContext.cannyEdges.empty()) {
+        // Hysteresis already ran over the whole image (see TiledProcessor)
+        tileContext.cannyEdges.copyTo(result.edgeImage);
     } else {
-        // Gaussian blur - ensure kernel size is odd and >= 1
-        int kernelSize = std::max(1, blurStrength);
-        if (kernelSize % 2 == 0) kernelSize++;
-        cv::GaussianBlur(gray, blurred, cv::Size(kernelSize, kernelSize), 0);
+        // Canny edge detection: hysteresis on the cached gradients
+        prepareEdges();
+        edgeCache.canny.edges(params.cannyThreshold1, params.cannyThreshold2, result.edgeImage);
     }
 
-    // Canny edge detection
-    cv::Canny(blurred, edgeImage, cannyThreshold1, cannyThreshold2);
-    
     // Apply morphological operations to reduce noise
-    if (morphologySize > 0) {
-        int kernelSize = morphologySize;
+    if (params.morphologySize > 0) {
+        int kernelSize = params.morphologySize;
         if (kernelSize % 2 == 0) kernelSize++;
         cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(kernelSize, kernelSize));
         
         // Close operation (dilate then erode) - fills small gaps
-        cv::morphologyEx(edgeImage, edgeImage, cv::MORPH_CLOSE, kernel);
+        cv::morphologyEx(result.edgeImage, result.edgeImage, cv::MORPH_CLOSE, kernel);
         
         // Open operation (erode then dilate) - removes small noise
-        cv::morphologyEx(edgeImage, edgeImage, cv::MORPH_OPEN, kernel);
+        cv::morphologyEx(result.edgeImage, result.edgeImage, cv::MORPH_OPEN, kernel);
     }
     
     // Edge dilation to connect fragmented edges (like hair strands)
-    if (edgeDilation > 0) {
-        int kernelSize = edgeDilation;
+    if (params.edgeDilation > 0) {
+        int kernelSize = params.edgeDilation;
         if (kernelSize % 2 == 0) kernelSize++;
         cv::Mat dilateKernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(kernelSize, kernelSize));
-        cv::dilate(edgeImage, edgeImage, dilateKernel);
+        cv::dilate(result.edgeImage, result.edgeImage, dilateKernel);
         
         // Re-thin edges using skeletonization approximation
         cv::Mat thinned;
-        cv::ximgproc::thinning(edgeImage, thinned, cv::ximgproc::THINNING_ZHANGSUEN);
-        edgeImage = thinned;
+        cv::ximgproc::thinning(result.edgeImage, thinned, cv::ximgproc::THINNING_ZHANGSUEN);
+        result.edgeImage = thinned;
     }
     
     // Edge smoothing - blur the edge image then re-threshold
-    if (edgeSmoothing > 0) {
-        int kernelSize = edgeSmoothing;
+    if (params.edgeSmoothing > 0) {
+        int kernelSize = params.edgeSmoothing;
         if (kernelSize % 2 == 0) kernelSize++;
-        cv::GaussianBlur(edgeImage, edgeImage, cv::Size(kernelSize, kernelSize), 0);
-        cv::threshold(edgeImage, edgeImage, 30, 255, cv::THRESH_BINARY);
+        cv::GaussianBlur(result.edgeImage, result.edgeImage, cv::Size(kernelSize, kernelSize), 0);
+        cv::threshold(result.edgeImage, result.edgeImage, 30, 255, cv::THRESH_BINARY);
     }
 }
 
 void ImageProcessor::findContours() {
-    if (edgeImage.empty()) {
+    if (result.edgeImage.empty()) {
         return;
     }
 
-    contours.clear();
-    cv::Mat tempEdge = edgeImage.clone();
-    std::vector<cv::Vec4i> hierarchy;
+    ContourCache& cache = contourCache;
+    if (!cache.valid) {
+        cv::Mat tempEdge = result.edgeImage.clone();
+        std::vector<cv::Vec4i> hierarchy;
 
-    cv::findContours(tempEdge, contours, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
+        cv::findContours(tempEdge, cache.traced, hierarchy, cv::RETR_TREE, cv::CHAIN_APPROX_SIMPLE);
 
-    // Filter contours by area and arc length
-    std::vector<std::vector<cv::Point>> filteredContours;
-    for (const auto& contour : contours) {
-        double area = cv::contourArea(contour);
-        double length = cv::arcLength(contour, false);
-        
-        // Filter out small contours by area AND length
-        if (area > contourMinArea && length > minContourLength) {
-            // Apply contour smoothing if enabled
-            if (contourSmoothing > 0) {
-                std::vector<cv::Point> smoothed;
-                cv::approxPolyDP(contour, smoothed, contourSmoothing, false);
-                if (smoothed.size() >= 2) {
-                    filteredContours.push_back(smoothed);
-                }
-            } else {
-                filteredContours.push_back(contour);
+        size_t pointCount = 0;
+        for (const auto& contour : cache.traced) {
+            pointCount += contour.size();
+        }
+        cache.raw.clear();
+        cache.raw.reserve(cache.traced.size(), pointCount);
+        for (const auto& contour : cache.traced) {
+            cache.raw.add(contour);
+        }
+        cache.byArea.resize(cache.raw.size());
+        for (size_t i = 0; i < cache.byArea.size(); ++i) {
+            cache.byArea[i] = static_cast<int>(i);
+        }
+        std::sort(cache.byArea.begin(), cache.byArea.end(), [&cache](int a, int b) {
+            return cache.raw.features(a).area < cache.raw.features(b).area;
+        });
+        cache.smoothedState.assign(cache.raw.size(), 0);
+        cache.smoothed.resize(cache.raw.size());
+        cache.smoothedFeatures.resize(cache.raw.size());
+        cache.valid = true;
+    }
+
+    // Filter contours by area and arc length: a binary search on area, then
+    // a length check on what is left, back in cv::findContours order
+    auto firstAbove = std::upper_bound(cache.byArea.begin(), cache.byArea.end(), params.contourMinArea,
+                                       [&cache](double minArea, int i) { return minArea < cache.raw.features(i).area; });
+    std::vector<int> kept;
+    kept.reserve(static_cast<size_t>(cache.byArea.end() - firstAbove));
+    for (auto it = firstAbove; it != cache.byArea.end(); ++it) {
+        if (cache.raw.features(*it).length > params.minContourLength) {
+            kept.push_back(*it);
+        }
+    }
+    std::sort(kept.begin(), kept.end());
+
+    // Apply contour smoothing if enabled (memoized per epsilon)
+    const bool smoothing = params.contourSmoothing > 0;
+    if (smoothing && cache.epsilon != params.contourSmoothing) {
+        cache.smoothedState.assign(cache.raw.size(), 0);
+        cache.epsilon = params.contourSmoothing;
+    }
+
+    size_t pointCount = 0;
+    for (int i : kept) {
+        pointCount += cache.raw[i].size();
+    }
+    result.contours.clear();
+    result.contours.reserve(kept.size(), pointCount);
+    for (int i : kept) {
+        if (!smoothing) {
+            result.contours.add(cache.raw[i], cache.raw.features(i));
+            continue;
+        }
+        if (cache.smoothedState[i] == 0) {
+            cv::approxPolyDP(cache.raw[i].mat(), cache.smoothed[i], params.contourSmoothing, false);
+            const bool keep = cache.smoothed[i].size() >= 2;
+            if (keep) {
+                cache.smoothedFeatures[i] = ContourSet::measure(cache.smoothed[i]);
             }
+            cache.smoothedState[i] = keep ? 1 : 2;
+        }
+        if (cache.smoothedState[i] == 1) {
+            const std::vector<cv::Point>& contour = cache.smoothed[i];
+            result.contours.add(ContourSet::View(contour.data(), contour.size()), cache.smoothedFeatures[i]);
         }
     }
 
-    contours = filteredContours;
+    if (temporalCoherence) {
+        matchContours();
+    } else if (!tileContext.contourLabels.empty()) {
+        assignTileContourIds();
+    } else {
+        contourIds.clear();
+    }
+}
+
+void ImageProcessor::assignTileContourIds() {
+    // Contour points lie on edge pixels, so the first labelled point names
+    // the whole-image component this piece of contour belongs to
+    const cv::Mat& labels = tileContext.contourLabels;
+    contourIds.assign(result.contours.size(), 0);
+    for (size_t i = 0; i < result.contours.size(); ++i) {
+        uint32_t id = 0;
+        for (const auto& p : result.contours[i]) {
+            if (p.x < 0 || p.x >= labels.cols || p.y < 0 || p.y >= labels.rows) continue;
+            const int lbl = labels.at<int>(p.y, p.x);
+            if (lbl > 0) {
+                id = static_cast<uint32_t>(lbl);
+                break;
+            }
+        }
+        // Unlabelled pieces (edges that differ slightly from the labelling
+        // pass near a tile border) get an id of their own
+        contourIds[i] = id > 0 ? id : 0x80000000u | static_cast<uint32_t>(i);
+    }
+}
+
+void ImageProcessor::matchContours() {
+    // Previous contours are bucketed on a grid with cells as large as the
+    // match radius, so each lookup only scans the 3x3 neighbourhood.
+    const float matchRadius = 12.0f;
+    const float maxAreaRatio = 2.0f;
+    auto cellKey = [matchRadius](const cv::Point2f& p) {
+        return gridCellKey(p, matchRadius);
+    };
+
+    const std::vector<TrackedContour>& previous = temporal.contours;
+    std::unordered_map<uint64_t, std::vector<int>> grid;
+    grid.reserve(previous.size());
+    for (int i = 0; i < static_cast<int>(previous.size()); ++i) {
+        grid[cellKey(previous[i].centroid)].push_back(i);
+    }
+    std::vector<uint8_t> taken(previous.size(), 0);
+
+    std::vector<TrackedContour> current(result.contours.size());
+    contourIds.assign(result.contours.size(), 0);
+    for (size_t i = 0; i < result.contours.size(); ++i) {
+        TrackedContour& tc = current[i];
+        tc.centroid = result.contours.features(i).centroid;
+        tc.area = std::max(1.0, result.contours.features(i).area);
+
+        // Closest unclaimed previous contour of similar size
+        int best = -1;
+        float bestDist2 = matchRadius * matchRadius;
+        for (int dy = -1; dy <= 1; ++dy) {
+            for (int dx = -1; dx <= 1; ++dx) {
+                const cv::Point2f probe(tc.centroid.x + dx * matchRadius, tc.centroid.y + dy * matchRadius);
+                auto it = grid.find(cellKey(probe));
+                if (it == grid.end()) continue;
+                for (int j : it->second) {
+                    if (taken[j]) continue;
+                    const double ratio = tc.area / previous[j].area;
+                    if (ratio > maxAreaRatio || ratio < 1.0 / maxAreaRatio) continue;
+                    const float ex = tc.centroid.x - previous[j].centroid.x;
+                    const float ey = tc.centroid.y - previous[j].centroid.y;
+                    const float d2 = ex * ex + ey * ey;
+                    if (d2 < bestDist2) {
+                        bestDist2 = d2;
+                        best = j;
+                    }
+                }
+            }
+        }
+
+        if (best >= 0) {
+            taken[best] = 1;
+            tc.id = previous[best].id;
+        } else {
+            tc.id = temporal.nextId++;
+        }
+        contourIds[i] = tc.id;
+    }
+    temporal.contours = std::move(current);
 }
 
 void ImageProcessor::createBrushStrokes() {
-    if (originalImage.empty() || edgeImage.empty()) {
+    if (result.originalImage.empty() || result.edgeImage.empty()) {
         return;
     }
 
     // Create black background for brush strokes
-    brushStrokeImage = cv::Mat::zeros(originalImage.size(), CV_8UC3);
+    result.brushStrokeImage = cv::Mat::zeros(result.originalImage.size(), CV_8UC3);
     
-    // Compute gradient direction using Sobel
-    cv::Mat gray;
-    if (originalImage.channels() == 3) {
-        cv::cvtColor(originalImage, gray, cv::COLOR_RGB2GRAY);
-    } else {
-        gray = originalImage.clone();
-    }
-    
-    cv::Mat gradX, gradY;
-    cv::Sobel(gray, gradX, CV_32F, 1, 0, 3);
-    cv::Sobel(gray, gradY, CV_32F, 0, 1, 3);
+    // Gradient direction from the Sobel pass made when the image was set
+    const ImageFeatures& invariant = imageFeatures();
+    const cv::Mat& gradX = invariant.gradX;
+    const cv::Mat& gradY = invariant.gradY;
     
     // Compute edge density map - how many edge pixels in local neighborhood
     cv::Mat edgeDensity;
-    int densityKernelSize = 21;  // Size of neighborhood to check
-    cv::blur(edgeImage, edgeDensity, cv::Size(densityKernelSize, densityKernelSize));
+    int densityKernelSize = std::max(1, params.edgeDensityKernel);  // Size of neighborhood to check
+    cv::blur(result.edgeImage, edgeDensity, cv::Size(densityKernelSize, densityKernelSize));
     
     // Normalize density to 0-1 range
     double minDensity, maxDensity;
-    cv::minMaxLoc(edgeDensity, &minDensity, &maxDensity);
+    if (tileContext.densityMax >= tileContext.densityMin) {
+        minDensity = tileContext.densityMin;
+        maxDensity = tileContext.densityMax;
+    } else {
+        cv::minMaxLoc(edgeDensity, &minDensity, &maxDensity);
+    }
     if (maxDensity > minDensity) {
         edgeDensity.convertTo(edgeDensity, CV_32F, 1.0 / (maxDensity - minDensity), -minDensity / (maxDensity - minDensity));
     } else {
         edgeDensity.convertTo(edgeDensity, CV_32F, 0, 0.5);
     }
     
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> offsetDist(-1, 1);  // Reduced position jitter
-    std::uniform_int_distribution<> sizeDist(-1, 1);
-    std::uniform_int_distribution<> signDist(0, 1);
-    std::uniform_real_distribution<> skipDist(0.0, 1.0);
-    
+    // Temporal mode: blocks whose edges barely moved since they were last
+    // drawn keep the previous frame's strokes; only changed blocks are redrawn.
+    const int blockSize = 32;
+    const bool reuse = temporalCoherence &&
+                       temporal.brushStrokeImage.size() == result.originalImage.size() &&
+                       temporal.brushSize == params.brushSize &&
+                       temporal.brushDensity == params.brushDensity &&
+                       temporal.brushBackend == params.brushBackend &&
+                       temporal.seed == params.seed &&
+                       temporal.edgeDensityKernel == params.edgeDensityKernel;
+    cv::Mat changedBlocks;  // One byte per block
+    cv::Mat copyMask;       // Pixels taken from this frame's strokes
+    cv::Mat drawMask;       // Edge pixels whose strokes can reach copyMask
+    if (reuse) {
+        cv::Mat diff;
+        cv::bitwise_xor(result.edgeImage, temporal.referenceEdges, diff);
+        const int blocksX = (diff.cols + blockSize - 1) / blockSize;
+        const int blocksY = (diff.rows + blockSize - 1) / blockSize;
+        changedBlocks = cv::Mat::zeros(blocksY, blocksX, CV_8UC1);
+        copyMask = cv::Mat::zeros(diff.size(), CV_8UC1);
+        const cv::Rect bounds(0, 0, diff.cols, diff.rows);
+        for (int by = 0; by < blocksY; ++by) {
+            for (int bx = 0; bx < blocksX; ++bx) {
+                const cv::Rect block = cv::Rect(bx * blockSize, by * blockSize, blockSize, blockSize) & bounds;
+                if (cv::countNonZero(diff(block)) > temporalEdgeThreshold * block.area()) {
+                    changedBlocks.at<uchar>(by, bx) = 255;
+                    copyMask(block).setTo(255);
+                }
+            }
+        }
+
+        if (cv::countNonZero(changedBlocks) == 0) {
+            result.brushStrokeImage = temporal.brushStrokeImage;
+            return;
+        }
+
+        // Edge-pixel strokes are brushSize * 2 long plus one pixel of jitter
+        const int reach = params.brushSize * 2 + 2;
+        cv::dilate(copyMask, drawMask, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2 * reach + 1, 2 * reach + 1)));
+    }
+
+    // Contour strokes overshoot their segment a little, so a contour is
+    // redrawn when any block within one block of its bounding box changed
+    auto touchesChangedBlock = [&](const cv::Rect& box) {
+        const int x0 = std::max(0, box.x / blockSize - 1);
+        const int y0 = std::max(0, box.y / blockSize - 1);
+        const int x1 = std::min(changedBlocks.cols - 1, (box.x + box.width) / blockSize + 1);
+        const int y1 = std::min(changedBlocks.rows - 1, (box.y + box.height) / blockSize + 1);
+        if (x1 < x0 || y1 < y0) return false;
+        return cv::countNonZero(changedBlocks(cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1))) > 0;
+    };
+
+    // Strokes are gray, so the stamp atlas draws into one channel and the
+    // result is expanded to RGB at the end
+    const bool useAtlas = params.brushBackend == BRUSH_STAMP_ATLAS;
+    if (useAtlas) {
+        strokeRasterizer.begin(result.brushStrokeImage.size());
+    }
+    auto drawStroke = [&](cv::Point p1, cv::Point p2, int grayVal, int thickness) {
+        if (useAtlas) {
+            strokeRasterizer.draw(cv::Point2f(p1), cv::Point2f(p2), grayVal, thickness);
+        } else {
+            cv::line(result.brushStrokeImage, p1, p2, cv::Scalar(grayVal, grayVal, grayVal), thickness, cv::LINE_AA);
+        }
+    };
+
+    // Every random draw comes from a counter-based stream keyed by the seed
+    // and the contour or pixel it belongs to, so strokes do not depend on
+    // processing order or thread count.
+    enum : uint64_t { STREAM_CONTOUR = 1, STREAM_EDGE_PIXEL = 2 };
+    const uint64_t seed = static_cast<uint32_t>(params.seed);
+
     // Reduced angle offsets for tighter edge following
     const float maxAngleOffset = 5.0f * CV_PI / 180.0f;   // Max 5 degrees
     const float minAngleOffset = 0.5f * CV_PI / 180.0f;   // Min 0.5 degrees
     
     // Draw brush strokes along contours with sketchy effect
-    for (const auto& contour : contours) {
+    for (size_t c = 0; c < result.contours.size(); ++c) {
+        const ContourSet::View contour = result.contours[c];
         if (contour.size() < 2) continue;
+        if (reuse && !touchesChangedBlock(result.contours.features(c).bbox)) continue;
+
+        // A contour with a stable id (tracked across frames or tiles) keeps
+        // its jitter, so its strokes only move when its geometry does
+        const uint64_t streamIndex = contourIds.size() == result.contours.size() ? contourIds[c] : c;
+        CounterRng rng(seed, STREAM_CONTOUR, streamIndex);
         
         // Draw main stroke along contour
         for (size_t i = 0; i < contour.size() - 1; i++) {
@@ -250,27 +1066,26 @@ void ImageProcessor::createBrushStrokes() {
             
             // Skip some strokes in high-density areas (up to 70%)
             float skipProbability = density * 0.7f;
-            if (skipDist(gen) < skipProbability) {
+            if (rng.uniform() < skipProbability) {
                 continue;
             }
             
             // Small angle offset for brush effect while following edge
             float angleRange = std::max(minAngleOffset, maxAngleOffset - (density * (maxAngleOffset - minAngleOffset)));
-            std::uniform_real_distribution<> angleOffsetDist(0.0, angleRange);
             
             // Calculate tangent direction from contour points
             float tangentAngle = atan2(pt2.y - pt1.y, pt2.x - pt1.x);
             
             // Add small random angle offset
-            float angleOffset = angleOffsetDist(gen) * (signDist(gen) ? 1 : -1);
+            float angleOffset = rng.uniform() * angleRange * (rng.uniformInt(0, 1) ? 1 : -1);
             float strokeAngle = tangentAngle + angleOffset;
             
             // Calculate stroke length - slightly longer for smoother look
             float strokeLen = sqrt(pow(pt2.x - pt1.x, 2) + pow(pt2.y - pt1.y, 2)) * 1.1f;
             
             // Minimal position variation
-            int offset_x = offsetDist(gen);
-            int offset_y = offsetDist(gen);
+            int offset_x = rng.uniformInt(-1, 1);
+            int offset_y = rng.uniformInt(-1, 1);
             
             cv::Point strokePt1(pt1.x + offset_x, pt1.y + offset_y);
             cv::Point strokePt2(
@@ -280,18 +1095,15 @@ void ImageProcessor::createBrushStrokes() {
             
             // More consistent brightness
             int baseGray = 220 + static_cast<int>((1.0f - density) * 35);  // 220-255 range
-            std::uniform_int_distribution<> grayDist(std::max(200, baseGray - 15), baseGray);
-            int grayVal = grayDist(gen);
-            int thickness = std::max(1, brushSize + sizeDist(gen));
+            int grayVal = rng.uniformInt(std::max(200, baseGray - 15), baseGray);
+            int thickness = std::max(1, params.brushSize + rng.uniformInt(-1, 1));
             
             // Draw the main stroke
-            cv::line(brushStrokeImage, strokePt1, strokePt2, 
-                     cv::Scalar(grayVal, grayVal, grayVal), 
-                     thickness, cv::LINE_AA);
+            drawStroke(strokePt1, strokePt2, grayVal, thickness);
         }
         
         // Add secondary "sketch" lines with slight offset for texture
-        if (brushDensity < 15) {
+        if (params.brushDensity < 15) {
             for (size_t i = 0; i < contour.size() - 1; i += 3) {
                 cv::Point pt1 = contour[i];
                 cv::Point pt2 = contour[std::min(i + 3, contour.size() - 1)];
@@ -304,22 +1116,20 @@ void ImageProcessor::createBrushStrokes() {
                 
                 // Skip in dense areas
                 float skipProbability = density * 0.8f;
-                if (skipDist(gen) < skipProbability) {
+                if (rng.uniform() < skipProbability) {
                     continue;
                 }
                 
                 float angleRange = std::max(minAngleOffset, maxAngleOffset - (density * (maxAngleOffset - minAngleOffset)));
-                std::uniform_real_distribution<> angleOffsetDist(0.0, angleRange);
                 
                 float tangentAngle = atan2(pt2.y - pt1.y, pt2.x - pt1.x);
-                float angleOffset = angleOffsetDist(gen) * (signDist(gen) ? 1 : -1);
+                float angleOffset = rng.uniform() * angleRange * (rng.uniformInt(0, 1) ? 1 : -1);
                 float strokeAngle = tangentAngle + angleOffset;
                 float strokeLen = sqrt(pow(pt2.x - pt1.x, 2) + pow(pt2.y - pt1.y, 2));
                 
-                int offset = offsetDist(gen);
+                int offset = rng.uniformInt(-1, 1);
                 int baseGray = 200 + static_cast<int>((1.0f - density) * 40);
-                std::uniform_int_distribution<> grayDist2(std::max(180, baseGray - 15), baseGray);
-                int grayVal = grayDist2(gen);
+                int grayVal = rng.uniformInt(std::max(180, baseGray - 15), baseGray);
                 
                 cv::Point strokePt1(pt1.x + offset, pt1.y + offset);
                 cv::Point strokePt2(
@@ -327,70 +1137,108 @@ void ImageProcessor::createBrushStrokes() {
                     pt1.y + offset + static_cast<int>(strokeLen * sin(strokeAngle))
                 );
                 
-                cv::line(brushStrokeImage, strokePt1, strokePt2, 
-                         cv::Scalar(grayVal, grayVal, grayVal), 
-                         std::max(1, brushSize - 1), cv::LINE_AA);
+                drawStroke(strokePt1, strokePt2, grayVal, std::max(1, params.brushSize - 1));
             }
         }
     }
     
-    // Add brush strokes along edge pixels for finer detail
-    for (int y = 1; y < edgeImage.rows - 1; y++) {
-        for (int x = 1; x < edgeImage.cols - 1; x++) {
-            if (edgeImage.at<uchar>(y, x) > 128) {
+    // Add brush strokes along edge pixels for finer detail. Rows are
+    // generated in parallel into per-row lists and then drawn in raster
+    // order, so the image is the same for any thread count.
+    struct EdgeStroke {
+        cv::Point pt1, pt2;
+        int gray;
+    };
+    std::vector<std::vector<EdgeStroke>> rowStrokes(static_cast<size_t>(result.edgeImage.rows));
+
+    // Pixel streams are keyed by whole-image coordinates, so a tile draws
+    // the same strokes as the untiled image would
+    const int64_t indexWidth = tileContext.fullWidth > 0 ? tileContext.fullWidth : result.edgeImage.cols;
+    const cv::Point indexOrigin = tileContext.origin;
+    const int strokeLen = params.brushSize * 2;
+
+    cv::parallel_for_(cv::Range(1, std::max(1, result.edgeImage.rows - 1)), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++) {
+            const uchar* edgeRow = result.edgeImage.ptr<uchar>(y);
+            const float* densityRow = edgeDensity.ptr<float>(y);
+            const int16_t* gradXRow = gradX.ptr<int16_t>(y);
+            const int16_t* gradYRow = gradY.ptr<int16_t>(y);
+            const uchar* drawRow = reuse ? drawMask.ptr<uchar>(y) : nullptr;
+            std::vector<EdgeStroke>& strokes = rowStrokes[y];
+            for (int x = 1; x < result.edgeImage.cols - 1; x++) {
+                if (drawRow && !drawRow[x]) continue;
+                if (edgeRow[x] <= 128) continue;
+
+                const int64_t pixelIndex = (y + indexOrigin.y) * indexWidth + (x + indexOrigin.x);
+                CounterRng rng(seed, STREAM_EDGE_PIXEL, static_cast<uint64_t>(pixelIndex));
+
                 // Get local density at this point
-                float density = edgeDensity.at<float>(y, x);
+                float density = densityRow[x];
                 
                 // Skip more in dense areas
                 float skipProbability = density * 0.75f;
-                if (skipDist(gen) < skipProbability) {
+                if (rng.uniform() < skipProbability) {
                     continue;
                 }
                 
                 // Tight angle offset for edge following
                 float angleRange = std::max(minAngleOffset, maxAngleOffset - (density * (maxAngleOffset - minAngleOffset)));
-                std::uniform_real_distribution<> angleOffsetDist(0.0, angleRange);
-                
-                // Get gradient direction (perpendicular to edge)
-                float gx = gradX.at<float>(y, x);
-                float gy = gradY.at<float>(y, x);
                 
                 // Gradient angle is perpendicular to edge, so add 90 degrees to get tangent
-                float gradientAngle = atan2(gy, gx);
+                float gradientAngle = atan2(static_cast<float>(gradYRow[x]), static_cast<float>(gradXRow[x]));
                 float tangentAngle = gradientAngle + CV_PI / 2.0;  // Rotate 90 degrees to get edge direction
                 
                 // Add small random angle offset
-                float angleOffset = angleOffsetDist(gen) * (signDist(gen) ? 1 : -1);
+                float angleOffset = rng.uniform() * angleRange * (rng.uniformInt(0, 1) ? 1 : -1);
                 float strokeAngle = tangentAngle + angleOffset;
                 
-                int strokeLen = brushSize * 2;
                 int dx = static_cast<int>(strokeLen * cos(strokeAngle));
                 int dy = static_cast<int>(strokeLen * sin(strokeAngle));
                 
                 // Consistent brightness
                 int baseGray = 210 + static_cast<int>((1.0f - density) * 45);
-                std::uniform_int_distribution<> grayDist3(std::max(190, baseGray - 15), baseGray);
-                int grayVal = grayDist3(gen);
-                int offset = offsetDist(gen);
+                int grayVal = rng.uniformInt(std::max(190, baseGray - 15), baseGray);
+                int offset = rng.uniformInt(-1, 1);
                 
-                cv::Point pt1(x + offset, y + offset);
-                cv::Point pt2(x + dx + offset, y + dy + offset);
-                
-                cv::line(brushStrokeImage, pt1, pt2, 
-                         cv::Scalar(grayVal, grayVal, grayVal), 
-                         std::max(1, brushSize / 2), cv::LINE_AA);
+                strokes.push_back({cv::Point(x + offset, y + offset), cv::Point(x + dx + offset, y + dy + offset), grayVal});
             }
         }
+    });
+
+    const int edgeThickness = std::max(1, params.brushSize / 2);
+    for (const auto& strokes : rowStrokes) {
+        for (const EdgeStroke& stroke : strokes) {
+            drawStroke(stroke.pt1, stroke.pt2, stroke.gray, edgeThickness);
+        }
+    }
+
+    if (useAtlas) {
+        cv::cvtColor(strokeRasterizer.canvas(), result.brushStrokeImage, cv::COLOR_GRAY2RGB);
+    }
+
+    if (reuse) {
+        cv::Mat merged = temporal.brushStrokeImage.clone();
+        result.brushStrokeImage.copyTo(merged, copyMask);
+        result.brushStrokeImage = merged;
+        result.edgeImage.copyTo(temporal.referenceEdges, copyMask);
+    } else if (temporalCoherence) {
+        temporal.referenceEdges = result.edgeImage.clone();
+    }
+    if (temporalCoherence) {
+        temporal.brushStrokeImage = result.brushStrokeImage;
+        temporal.brushSize = params.brushSize;
+        temporal.brushDensity = params.brushDensity;
+        temporal.brushBackend = params.brushBackend;
+        temporal.seed = params.seed;
+        temporal.edgeDensityKernel = params.edgeDensityKernel;
     }
 }
 
 void ImageProcessor::createNeonEffect() {
-    if (originalImage.empty() || edgeImage.empty()) {
+    if (result.originalImage.empty() || result.edgeImage.empty()) {
         return;
     }
 
-    neonImage = cv::Mat::zeros(originalImage.size(), CV_8UC3);
-
     const std::vector<cv::Scalar> neonPalette = {
         cv::Scalar(255, 0, 255),   // Magenta
         cv::Scalar(255, 255, 0),   // Cyan
@@ -406,10 +1254,17 @@ void ImageProcessor::createNeonEffect() {
         cv::Scalar(255, 255, 127), // Light Cyan
     };
 
-    cv::Mat edgeLayer = cv::Mat::zeros(originalImage.size(), CV_8UC3);
-    cv::Mat contourLayer = cv::Mat::zeros(originalImage.size(), CV_8UC3);
-    cv::Mat whiteCore = cv::Mat::zeros(originalImage.size(), CV_8UC3);
-    bool hasWhiteCore = false;
+    const std::vector<NeonGlow::Pass> glowPasses = NeonGlow::passes(params.neonGlowSize, params.neonGlowStrength);
+    auto blurGlow = [&](const cv::Mat& layer) {
+        return params.neonGlowBackend == GLOW_PYRAMID ? NeonGlow::pyramid(layer, glowPasses)
+                                                      : NeonGlow::gaussian(layer, glowPasses);
+    };
+
+    cv::Mat& edgeMask = neonLayers.edgeMask;
+    cv::Mat& contourLayer = neonLayers.contours;
+    cv::Mat& contourGlow = neonLayers.contourGlow;
+    contourLayer = cv::Mat::zeros(result.originalImage.size(), CV_8UC3);
+    cv::Mat whiteCore;
 
     auto hsvToBgr = [](float hDeg, float s, float v) -> cv::Scalar {
         hDeg = std::fmod(hDeg, 360.0f);
@@ -454,33 +1309,55 @@ void ImageProcessor::createNeonEffect() {
         return cv::Scalar(b, g, r);
     };
 
-    if (neonPerContour) {
+    if (params.neonPerContour) {
         // Background edges = all edges
-        edgeLayer.setTo(neonEdgeColor, edgeImage);
+        cv::compare(result.edgeImage, 0, edgeMask, cv::CMP_GT);
 
-        std::vector<int> clusterId(contours.size(), 0);
-        const int n = static_cast<int>(contours.size());
-        if (neonKMeansEnabled && n >= 2) {
-            int k = std::clamp(neonKMeansK, 1, n);
+        std::vector<int> clusterId(result.contours.size(), 0);
+        const int n = static_cast<int>(result.contours.size());
+        // Ids that stay the same across frames or tiles keep colors consistent
+        const bool stableIds = contourIds.size() == result.contours.size();
+        if (params.neonKMeansEnabled && stableIds && tileContext.contourColors) {
+            // Grouped once over the whole image, so a contour has the same
+            // color in every tile
+            const std::unordered_map<int, int>& colors = *tileContext.contourColors;
+            for (int i = 0; i < n; ++i) {
+                const int id = static_cast<int>(contourIds[i] & 0x7FFFFFFF);
+                auto it = colors.find(id);
+                clusterId[i] = it != colors.end() ? it->second : id;
+            }
+        } else if (params.neonKMeansEnabled && n >= 2 && params.neonGroupingBackend == GROUPING_GRID) {
+            std::vector<cv::Point2f> centroid(n);
+            for (int i = 0; i < n; ++i) {
+                centroid[i] = result.contours.features(i).centroid;
+            }
+            const std::vector<int> group = groupByRadius(centroid, params.neonKMeansNearDistancePx);
+
+            // A group is colored by its smallest stable id, so it keeps its
+            // color while members come and go; otherwise groups are numbered
+            // in order of their first contour
+            std::vector<int> groupColor(n, -1);
+            int next = 0;
+            for (int i = 0; i < n; ++i) {
+                const int id = stableIds ? static_cast<int>(contourIds[i] & 0x7FFFFFFF) : next;
+                int& color = groupColor[group[i]];
+                if (color < 0) {
+                    color = id;
+                    if (!stableIds) next++;
+                } else if (stableIds) {
+                    color = std::min(color, id);
+                }
+            }
+            for (int i = 0; i < n; ++i) {
+                clusterId[i] = groupColor[group[i]];
+            }
+        } else if (params.neonKMeansEnabled && n >= 2) {
+            int k = std::clamp(params.neonKMeansK, 1, n);
 
             cv::Mat samples(n, 2, CV_32F);
             std::vector<cv::Point2f> centroid(n);
             for (int i = 0; i < n; ++i) {
-                cv::Point2f c(0.0f, 0.0f);
-                if (!contours[i].empty()) {
-                    cv::Moments m = cv::moments(contours[i]);
-                    if (std::fabs(m.m00) > 1e-5) {
-                        c.x = static_cast<float>(m.m10 / m.m00);
-                        c.y = static_cast<float>(m.m01 / m.m00);
-                    } else {
-                        for (const auto& p : contours[i]) {
-                            c.x += static_cast<float>(p.x);
-                            c.y += static_cast<float>(p.y);
-                        }
-                        c.x /= static_cast<float>(contours[i].size());
-                        c.y /= static_cast<float>(contours[i].size());
-                    }
-                }
+                const cv::Point2f c = result.contours.features(i).centroid;
                 centroid[i] = c;
                 samples.at<float>(i, 0) = c.x;
                 samples.at<float>(i, 1) = c.y;
@@ -488,11 +1365,33 @@ void ImageProcessor::createNeonEffect() {
 
             cv::Mat labels;
             cv::Mat centers;
-            cv::kmeans(samples, k, labels,
-                       cv::TermCriteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 20, 1.0),
-                       3, cv::KMEANS_PP_CENTERS, centers);
+            const cv::TermCriteria criteria(cv::TermCriteria::EPS + cv::TermCriteria::COUNT, 20, 1.0);
+            if (temporalCoherence && temporal.kmeansCenters.rows == k) {
+                // Warm start: label each centroid with the nearest center of
+                // the previous frame, so clusters (and colors) stay put
+                labels.create(n, 1, CV_32S);
+                for (int i = 0; i < n; ++i) {
+                    int best = 0;
+                    float bestD2 = std::numeric_limits<float>::max();
+                    for (int j = 0; j < k; ++j) {
+                        const float dx = centroid[i].x - temporal.kmeansCenters.at<float>(j, 0);
+                        const float dy = centroid[i].y - temporal.kmeansCenters.at<float>(j, 1);
+                        if (dx * dx + dy * dy < bestD2) {
+                            bestD2 = dx * dx + dy * dy;
+                            best = j;
+                        }
+                    }
+                    labels.at<int>(i, 0) = best;
+                }
+                cv::kmeans(samples, k, labels, criteria, 1, cv::KMEANS_USE_INITIAL_LABELS, centers);
+            } else {
+                cv::kmeans(samples, k, labels, criteria, 3, cv::KMEANS_PP_CENTERS, centers);
+            }
+            if (temporalCoherence) {
+                temporal.kmeansCenters = centers.clone();
+            }
 
-            const float nearPx = std::max(0.0f, neonKMeansNearDistancePx);
+            const float nearPx = std::max(0.0f, params.neonKMeansNearDistancePx);
             const float nearPx2 = nearPx * nearPx;
             int nextId = k;
             for (int i = 0; i < n; ++i) {
@@ -504,18 +1403,20 @@ void ImageProcessor::createNeonEffect() {
                 float d2 = dx * dx + dy * dy;
 
                 // Only keep grouping if it's truly nearby; otherwise isolate it.
+                // Tracked contours keep an id derived from their track.
                 if (nearPx > 0.0f && d2 > nearPx2) {
-                    clusterId[i] = nextId++;
+                    clusterId[i] = stableIds ? k + static_cast<int>(contourIds[i] & 0x7FFFFFFF) : nextId++;
                 } else {
                     clusterId[i] = lbl;
                 }
             }
 
-            // Compress ids to 0..M-1
+            // Compress ids to 0..M-1 (not with stable ids, where the remap
+            // would depend on contour order and make colors flicker)
             std::unordered_map<int, int> remap;
             remap.reserve(static_cast<size_t>(n));
             int next = 0;
-            for (int i = 0; i < n; ++i) {
+            for (int i = 0; i < n && !stableIds; ++i) {
                 auto it = remap.find(clusterId[i]);
                 if (it == remap.end()) {
                     remap.emplace(clusterId[i], next);
@@ -527,27 +1428,29 @@ void ImageProcessor::createNeonEffect() {
             }
         } else {
             for (int i = 0; i < n; ++i) {
-                clusterId[i] = i;
+                clusterId[i] = stableIds ? static_cast<int>(contourIds[i] & 0x7FFFFFFF) : i;
             }
         }
 
-        for (size_t i = 0; i < contours.size(); ++i) {
-            float hue = std::fmod(137.508f * static_cast<float>(clusterId[i]), 360.0f);
+        for (size_t i = 0; i < result.contours.size(); ++i) {
+            // Double precision: stable ids can be large
+            float hue = static_cast<float>(std::fmod(137.508 * static_cast<double>(clusterId[i]), 360.0));
             cv::Scalar color = hsvToBgr(hue, 0.95f, 1.0f);
-            cv::drawContours(contourLayer, contours, static_cast<int>(i), color, 3, cv::LINE_AA);
+            result.contours.draw(contourLayer, static_cast<int>(i), color, 3, cv::LINE_AA);
         }
+        contourGlow = blurGlow(contourLayer);
     } else {
         // Object grouping mode (keeps existing look, but now uses your adjustable params)
-        const int imgArea = originalImage.cols * originalImage.rows;
-        const int minObjectAreaPx = std::max(100, static_cast<int>(neonMinObjectAreaRatio * static_cast<float>(imgArea)));
-        const int maxObjects = std::max(1, neonMaxObjects);
+        const int imgArea = result.originalImage.cols * result.originalImage.rows;
+        const int minObjectAreaPx = std::max(100, static_cast<int>(params.neonMinObjectAreaRatio * static_cast<float>(imgArea)));
+        const int maxObjects = std::max(1, params.neonMaxObjects);
 
-        cv::Mat objectMask = cv::Mat::zeros(originalImage.size(), CV_8UC1);
-        for (size_t i = 0; i < contours.size(); i++) {
-            cv::drawContours(objectMask, contours, static_cast<int>(i), cv::Scalar(255), 2, cv::LINE_AA);
+        cv::Mat objectMask = cv::Mat::zeros(result.originalImage.size(), CV_8UC1);
+        for (size_t i = 0; i < result.contours.size(); i++) {
+            result.contours.draw(objectMask, static_cast<int>(i), cv::Scalar(255), 2, cv::LINE_AA);
         }
 
-        int joinSize = std::max(3, neonJoinSize);
+        int joinSize = std::max(3, params.neonJoinSize);
         if (joinSize % 2 == 0) joinSize++;
         cv::Mat joinKernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(joinSize, joinSize));
         cv::morphologyEx(objectMask, objectMask, cv::MORPH_CLOSE, joinKernel);
@@ -570,41 +1473,32 @@ void ImageProcessor::createNeonEffect() {
         }
 
         std::vector<uint8_t> selected(numLabels, 0);
-        std::vector<cv::Scalar> objectColors(numLabels, neonEdgeColor);
+        std::vector<cv::Scalar> objectColors(numLabels, params.neonEdgeColor);
         for (size_t i = 0; i < candidates.size(); ++i) {
             int lbl = candidates[i].second;
             selected[lbl] = 1;
             objectColors[lbl] = neonPalette[i % neonPalette.size()];
         }
 
-        cv::Mat selectedMask = cv::Mat::zeros(originalImage.size(), CV_8UC1);
-        for (int lbl = 1; lbl < numLabels; ++lbl) {
-            if (!selected[lbl]) continue;
-            cv::Mat cmp;
-            cv::compare(labels, lbl, cmp, cv::CMP_EQ);
-            cv::bitwise_or(selectedMask, cmp, selectedMask);
-        }
-
-        // Background edges: edges not in selected objects.
-        for (int y = 0; y < edgeImage.rows; ++y) {
-            const uchar* eRow = edgeImage.ptr<uchar>(y);
-            const uchar* sRow = selectedMask.ptr<uchar>(y);
-            cv::Vec3b* outRow = edgeLayer.ptr<cv::Vec3b>(y);
-            for (int x = 0; x < edgeImage.cols; ++x) {
-                if (eRow[x] > 128 && sRow[x] == 0) {
-                    outRow[x] = cv::Vec3b(
-                        static_cast<uchar>(neonEdgeColor[0]),
-                        static_cast<uchar>(neonEdgeColor[1]),
-                        static_cast<uchar>(neonEdgeColor[2])
-                    );
+        // Background edges: edges not in selected objects. One sweep over
+        // the label image with a label -> selected lookup per pixel
+        edgeMask.create(result.edgeImage.size(), CV_8UC1);
+        cv::parallel_for_(cv::Range(0, result.edgeImage.rows), [&](const cv::Range& rows) {
+            const uint8_t* isSelected = selected.data();
+            for (int y = rows.start; y < rows.end; ++y) {
+                const int* lRow = labels.ptr<int>(y);
+                const uchar* eRow = result.edgeImage.ptr<uchar>(y);
+                uchar* outRow = edgeMask.ptr<uchar>(y);
+                for (int x = 0; x < result.edgeImage.cols; ++x) {
+                    outRow[x] = (eRow[x] > 128 && !isSelected[lRow[x]]) ? 255 : 0;
                 }
             }
-        }
+        });
 
         // Assign contour -> label by sampling points.
-        std::vector<int> contourToObject(contours.size(), 0);
-        for (size_t i = 0; i < contours.size(); ++i) {
-            const auto& c = contours[i];
+        std::vector<int> contourToObject(result.contours.size(), 0);
+        for (size_t i = 0; i < result.contours.size(); ++i) {
+            const ContourSet::View c = result.contours[i];
             if (c.empty()) continue;
             const int sampleCount = std::min<int>(24, static_cast<int>(c.size()));
             const int step = std::max(1, static_cast<int>(c.size()) / sampleCount);
@@ -625,8 +1519,41 @@ void ImageProcessor::createNeonEffect() {
             }
             if (bestLbl > 0 && selected[bestLbl]) {
                 contourToObject[i] = bestLbl;
-                cv::drawContours(contourLayer, contours, static_cast<int>(i), objectColors[bestLbl], 3, cv::LINE_AA);
+                result.contours.draw(contourLayer, static_cast<int>(i), objectColors[bestLbl], 3, cv::LINE_AA);
+            }
+        }
+
+        // Glow per object: blur a single-channel mask of the object's lines,
+        // only over its neighborhood, and tint it with the object's color.
+        // Blur is linear, so this equals blurring the colored lines.
+        contourGlow = cv::Mat::zeros(result.originalImage.size(), CV_8UC3);
+        std::vector<std::vector<int>> objectContours(numLabels);
+        for (size_t i = 0; i < result.contours.size(); ++i) {
+            if (contourToObject[i] > 0) {
+                objectContours[contourToObject[i]].push_back(static_cast<int>(i));
+            }
+        }
+        const int reach = glowPasses.back().kernelSize + 3;
+        const cv::Rect imageRect(0, 0, result.originalImage.cols, result.originalImage.rows);
+        for (const auto& candidate : candidates) {
+            const std::vector<int>& members = objectContours[candidate.second];
+            if (members.empty()) continue;
+            cv::Rect box = result.contours.features(members[0]).bbox;
+            for (int idx : members) {
+                box |= result.contours.features(idx).bbox;
+            }
+            const cv::Rect roi = cv::Rect(box.x - reach, box.y - reach, box.width + 2 * reach, box.height + 2 * reach) & imageRect;
+
+            cv::Mat objectMask = cv::Mat::zeros(roi.size(), CV_8UC1);
+            for (int idx : members) {
+                result.contours.draw(objectMask, idx, cv::Scalar(255), 3, cv::LINE_AA, -roi.tl());
             }
+            const cv::Scalar& color = objectColors[candidate.second];
+            cv::Mat tinted;
+            cv::cvtColor(blurGlow(objectMask), tinted, cv::COLOR_GRAY2BGR);
+            cv::multiply(tinted, cv::Scalar(color[0] / 255.0, color[1] / 255.0, color[2] / 255.0), tinted);
+            cv::Mat target = contourGlow(roi);
+            cv::add(target, tinted, target);
         }
 
         // White core for the largest 3 selected objects
@@ -635,47 +1562,29 @@ void ImageProcessor::createNeonEffect() {
         for (int i = 0; i < coreObjects; ++i) {
             coreLabels[candidates[i].second] = 1;
         }
-        for (size_t i = 0; i < contours.size(); ++i) {
+        for (size_t i = 0; i < result.contours.size(); ++i) {
             const int objId = contourToObject[i];
             if (objId > 0 && objId < numLabels && coreLabels[objId]) {
-                cv::drawContours(whiteCore, contours, static_cast<int>(i), cv::Scalar(255, 255, 255), 1, cv::LINE_AA);
-                hasWhiteCore = true;
+                if (whiteCore.empty()) {
+                    whiteCore = cv::Mat::zeros(result.originalImage.size(), CV_8UC1);
+                }
+                result.contours.draw(whiteCore, static_cast<int>(i), cv::Scalar(255), 1, cv::LINE_AA);
             }
         }
     }
+    neonLayers.core = whiteCore;
 
-    // Glow + composite
-    cv::Mat glowEdge, glowContour;
-    const int glowStrength = std::max(1, neonGlowStrength);
-    for (int pass = 0; pass < glowStrength; ++pass) {
-        int blurSize = neonGlowSize + pass * 10;
-        if (blurSize % 2 == 0) blurSize++;
-
-        cv::Mat tempGlowEdge, tempGlowContour;
-        cv::GaussianBlur(edgeLayer, tempGlowEdge, cv::Size(blurSize, blurSize), 0);
-        cv::GaussianBlur(contourLayer, tempGlowContour, cv::Size(blurSize, blurSize), 0);
-
-        if (pass == 0) {
-            glowEdge = tempGlowEdge;
-            glowContour = tempGlowContour;
-        } else {
-            cv::addWeighted(glowEdge, 1.0, tempGlowEdge, 0.5, 0, glowEdge);
-            cv::addWeighted(glowContour, 1.0, tempGlowContour, 0.5, 0, glowContour);
-        }
-    }
-
-    cv::addWeighted(neonImage, 1.0, glowEdge, 0.6, 0, neonImage);
-    cv::addWeighted(neonImage, 1.0, glowContour, 1.2, 0, neonImage);
-
-    cv::Mat edgeLayerDim;
-    cv::addWeighted(edgeLayer, 0.5, cv::Mat::zeros(edgeLayer.size(), edgeLayer.type()), 0, 0, edgeLayerDim);
-    cv::add(neonImage, edgeLayerDim, neonImage);
-    cv::add(neonImage, contourLayer, neonImage);
+    // The background edge glow is blurred once as a single channel; its
+    // color is applied by compositeNeon()
+    neonLayers.edgeGlow = blurGlow(edgeMask);
+}
 
-    if (hasWhiteCore) {
-        cv::addWeighted(neonImage, 1.0, whiteCore, 0.5, 0, neonImage);
+void ImageProcessor::compositeNeon() {
+    const NeonLayers& l = neonLayers;
+    if (l.edgeMask.empty() || l.contours.empty()) {
+        return;
     }
-
-    cv::cvtColor(neonImage, neonImage, cv::COLOR_BGR2RGB);
+    NeonGlow::composite(l.edgeGlow, l.edgeMask, params.neonEdgeColor, l.contourGlow, l.contours, l.core,
+                        result.neonImage);
 }
 
@@ -0,0 +1,131 @@
+#include "IncrementalCanny.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// cv::Canny's fixed-point direction test: tan(22.5 deg) in Q15
+constexpr int kCannyShift = 15;
+const int kTg22 = static_cast<int>(0.4142135623730950488016887242097 * (1 << kCannyShift) + 0.5);
+
+// Integer thresholds as cv::Canny uses them
+void normalizeThresholds(double lowThreshold, double highThreshold, int& low, int& high) {
+    low = static_cast<int>(std::floor(lowThreshold));
+    high = static_cast<int>(std::floor(highThreshold));
+    if (low > high) std::swap(low, high);
+    low = std::max(low, 0);
+    high = std::max(high, low);
+}
+
+} // namespace
+
+void IncrementalCanny::prepare(const cv::Mat& blurred) {
+    CV_Assert(blurred.type() == CV_8UC1);
+    const int rows = blurred.rows;
+    const int cols = blurred.cols;
+
+    cv::Mat dx, dy;
+    cv::Sobel(blurred, dx, CV_16S, 1, 0, 3, 1, 0, cv::BORDER_REPLICATE);
+    cv::Sobel(blurred, dy, CV_16S, 0, 1, 3, 1, 0, cv::BORDER_REPLICATE);
+
+    // L1 magnitude with a ring of zeros around it, as cv::Canny pads it.
+    // At most 2 * 4 * 255, so it fits in 16 bits.
+    cv::Mat magnitude = cv::Mat::zeros(rows + 2, cols + 2, CV_16U);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y) {
+            const int16_t* gx = dx.ptr<int16_t>(y);
+            const int16_t* gy = dy.ptr<int16_t>(y);
+            uint16_t* m = magnitude.ptr<uint16_t>(y + 1) + 1;
+            for (int x = 0; x < cols; ++x) {
+                m[x] = static_cast<uint16_t>(std::abs(gx[x]) + std::abs(gy[x]));
+            }
+        }
+    });
+
+    // Non-maximum suppression along the quantized gradient direction, with
+    // the same comparisons (strict on one side) as cv::Canny
+    maxima.create(rows, cols, CV_16U);
+    cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y) {
+            const int16_t* gx = dx.ptr<int16_t>(y);
+            const int16_t* gy = dy.ptr<int16_t>(y);
+            const uint16_t* prev = magnitude.ptr<uint16_t>(y) + 1;
+            const uint16_t* cur = magnitude.ptr<uint16_t>(y + 1) + 1;
+            const uint16_t* next = magnitude.ptr<uint16_t>(y + 2) + 1;
+            uint16_t* out = maxima.ptr<uint16_t>(y);
+            for (int x = 0; x < cols; ++x) {
+                const int m = cur[x];
+                bool isMax = false;
+                if (m > 0) {
+                    const int xs = gx[x];
+                    const int ys = gy[x];
+                    const int ax = std::abs(xs);
+                    const int ay = std::abs(ys) << kCannyShift;
+                    const int tg22x = ax * kTg22;
+                    if (ay < tg22x) {
+                        isMax = m > cur[x - 1] && m >= cur[x + 1];
+                    } else {
+                        const int tg67x = tg22x + (ax << (kCannyShift + 1));
+                        if (ay > tg67x) {
+                            isMax = m > prev[x] && m >= next[x];
+                        } else {
+                            const int s = (xs ^ ys) < 0 ? -1 : 1;
+                            isMax = m > prev[x - s] && m > next[x + s];
+                        }
+                    }
+                }
+                out[x] = isMax ? static_cast<uint16_t>(m) : 0;
+            }
+        }
+    });
+}
+
+void IncrementalCanny::edges(double lowThreshold, double highThreshold, cv::Mat& out) {
+    CV_Assert(isPrepared());
+    int low, high;
+    normalizeThresholds(lowThreshold, highThreshold, low, high);
+
+    // Hysteresis as connected components of the candidates
+    cv::compare(maxima, low, candidates, cv::CMP_GT);
+    const int count = cv::connectedComponents(candidates, labels, 8, CV_32S, cv::CCL_DEFAULT);
+
+    std::vector<uint8_t> strong(static_cast<size_t>(std::max(count, 1)), 0);
+    for (int y = 0; y < maxima.rows; ++y) {
+        const uint16_t* m = maxima.ptr<uint16_t>(y);
+        const int* l = labels.ptr<int>(y);
+        for (int x = 0; x < maxima.cols; ++x) {
+            if (m[x] > high) strong[l[x]] = 1;
+        }
+    }
+
+    out.create(maxima.size(), CV_8UC1);
+    cv::parallel_for_(cv::Range(0, maxima.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y) {
+            const int* l = labels.ptr<int>(y);
+            uint8_t* o = out.ptr<uint8_t>(y);
+            for (int x = 0; x < maxima.cols; ++x) {
+                o[x] = strong[l[x]] ? 255 : 0;
+            }
+        }
+    });
+}
+
+void IncrementalCanny::classify(double lowThreshold, double highThreshold, cv::Mat& out) const {
+    CV_Assert(isPrepared());
+    int low, high;
+    normalizeThresholds(lowThreshold, highThreshold, low, high);
+
+    out.create(maxima.size(), CV_8UC1);
+    cv::parallel_for_(cv::Range(0, maxima.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y) {
+            const uint16_t* m = maxima.ptr<uint16_t>(y);
+            uint8_t* o = out.ptr<uint8_t>(y);
+            for (int x = 0; x < maxima.cols; ++x) {
+                o[x] = static_cast<uint8_t>((m[x] > low) + (m[x] > high));
+            }
+        }
+    });
+}
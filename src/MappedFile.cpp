@@ -0,0 +1,150 @@
+#include "MappedFile.h"
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& filepath, size_t size) {
+    close();
+    // Deleted by the OS once the last handle closes, even after a crash
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to create scratch file: " << filepath << std::endl;
+        return false;
+    }
+    const unsigned long long size64 = size;
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                                        static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xFFFFFFFF), nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+    if (!view) {
+        std::cerr << "Failed to map scratch file: " << filepath << std::endl;
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    path = filepath;
+    fileHandle = file;
+    mappingHandle = mapping;
+    ptr = static_cast<uint8_t*>(view);
+    length = size;
+    return true;
+}
+
+bool MappedFile::openRead(const std::string& filepath) {
+    close();
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size64;
+    if (!GetFileSizeEx(file, &size64) || size64.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    path = filepath;
+    fileHandle = file;
+    mappingHandle = mapping;
+    ptr = static_cast<uint8_t*>(view);
+    length = static_cast<size_t>(size64.QuadPart);
+    return true;
+}
+
+void MappedFile::close() {
+    if (ptr) UnmapViewOfFile(ptr);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    ptr = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    length = 0;
+    path.clear();
+}
+
+#else
+
+bool MappedFile::open(const std::string& filepath, size_t size) {
+    close();
+    int handle = ::open(filepath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (handle < 0) {
+        std::cerr << "Failed to create scratch file: " << filepath << std::endl;
+        return false;
+    }
+    // Unlink right away; the mapping keeps the data alive and nothing is left
+    // behind if the process dies
+    ::unlink(filepath.c_str());
+    if (::ftruncate(handle, static_cast<off_t>(size)) != 0) {
+        std::cerr << "Failed to size scratch file (disk full?): " << filepath << std::endl;
+        ::close(handle);
+        return false;
+    }
+    void* view = size > 0 ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0) : nullptr;
+    if (view == MAP_FAILED || (size > 0 && !view)) {
+        std::cerr << "Failed to map scratch file: " << filepath << std::endl;
+        ::close(handle);
+        return false;
+    }
+    path = filepath;
+    fd = handle;
+    ptr = static_cast<uint8_t*>(view);
+    length = size;
+    return true;
+}
+
+bool MappedFile::openRead(const std::string& filepath) {
+    close();
+    int handle = ::open(filepath.c_str(), O_RDONLY);
+    if (handle < 0) {
+        return false;
+    }
+    struct stat info;
+    if (::fstat(handle, &info) != 0 || info.st_size <= 0) {
+        ::close(handle);
+        return false;
+    }
+    const size_t size = static_cast<size_t>(info.st_size);
+    void* view = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, handle, 0);
+    if (view == MAP_FAILED) {
+        ::close(handle);
+        return false;
+    }
+    // The decoder reads the file front to back
+    ::madvise(view, size, MADV_SEQUENTIAL);
+    path = filepath;
+    fd = handle;
+    ptr = static_cast<uint8_t*>(view);
+    length = size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (ptr) ::munmap(ptr, length);
+    if (fd >= 0) ::close(fd);
+    ptr = nullptr;
+    fd = -1;
+    length = 0;
+    path.clear();
+}
+
+#endif
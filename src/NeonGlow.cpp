@@ -0,0 +1,224 @@
+#include "NeonGlow.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Sigma GaussianBlur derives from a kernel size when none is given
+double kernelSigma(int kernelSize) {
+    return 0.3 * ((kernelSize - 1) * 0.5 - 1.0) + 0.8;
+}
+
+// Variance (in full-resolution pixels^2) that a trip down to `level` and
+// back up adds on its own. pyrDown and pyrUp both filter with the 5-tap
+// binomial [1 4 6 4 1]/16, variance 1 in the pixels of the finer level.
+double pyramidVariance(int level) {
+    return 2.0 * (std::pow(4.0, level) - 1.0) / 3.0;
+}
+
+// Composite weights in fixed point. The contour glow is weighted in
+// 1/128ths (1.2 ~ 154); the edge masks carry their color in the weight, in
+// 1/256ths (0.6 * 255 ~ 154, 0.5 * 255 = 128). Every product fits in 16 bits.
+constexpr int kContourGlowWeight = 154;
+
+struct EdgeWeights {
+    int glow[3];    // Per BGR channel
+    int line[3];
+};
+
+EdgeWeights edgeWeights(const cv::Scalar& color) {
+    EdgeWeights w;
+    for (int ch = 0; ch < 3; ++ch) {
+        const double c = std::clamp(color[ch], 0.0, 255.0) / 255.0;
+        w.glow[ch] = static_cast<int>(std::lround(0.6 * c * 256.0));
+        w.line[ch] = static_cast<int>(std::lround(0.5 * c * 256.0));
+    }
+    return w;
+}
+
+inline uint8_t compositePixel(int edgeGlow, int edgeMask, int glowWeight, int lineWeight,
+                              int contourGlow, int contour, int core) {
+    // Same rounding as compositeLanes(), so the SIMD and scalar paths agree
+    const int value = ((((edgeGlow * glowWeight) >> 1) + ((edgeMask * lineWeight) >> 1) + 64) >> 7) +
+                      ((kContourGlowWeight * contourGlow + 64) >> 7) +
+                      ((core + 1) >> 1) + contour;
+    return static_cast<uint8_t>(std::min(value, 255));
+}
+
+#if CV_SIMD128
+// Edge glow and edge mask are at most 255 * 154 and 255 * 128, so their
+// weighted sum is formed as two halved products to stay under 65536
+inline cv::v_uint16x8 compositeLanes(const cv::v_uint16x8& edgeGlow, const cv::v_uint16x8& edgeMask,
+                                     const cv::v_uint16x8& glowWeight, const cv::v_uint16x8& lineWeight,
+                                     const cv::v_uint16x8& contourGlow, const cv::v_uint16x8& contour,
+                                     const cv::v_uint16x8& halfCore) {
+    const cv::v_uint16x8 edge = cv::v_shr<7>(cv::v_add(
+        cv::v_add(cv::v_shr<1>(cv::v_mul_wrap(edgeGlow, glowWeight)),
+                  cv::v_shr<1>(cv::v_mul_wrap(edgeMask, lineWeight))),
+        cv::v_setall_u16(64)));
+    const cv::v_uint16x8 glow = cv::v_shr<7>(cv::v_add(
+        cv::v_mul_wrap(contourGlow, cv::v_setall_u16(kContourGlowWeight)), cv::v_setall_u16(64)));
+    return cv::v_add(cv::v_add(edge, glow), cv::v_add(contour, halfCore));
+}
+
+// One channel of 16 pixels; v_pack saturates to 255
+inline cv::v_uint8x16 compositeChannel(const cv::v_uint16x8 edgeGlow[2], const cv::v_uint16x8 edgeMask[2],
+                                       int glowWeight, int lineWeight,
+                                       const cv::v_uint8x16& contourGlow, const cv::v_uint8x16& contour,
+                                       const cv::v_uint16x8 halfCore[2]) {
+    const cv::v_uint16x8 gw = cv::v_setall_u16(static_cast<uint16_t>(glowWeight));
+    const cv::v_uint16x8 lw = cv::v_setall_u16(static_cast<uint16_t>(lineWeight));
+    cv::v_uint16x8 gcLo, gcHi, cLo, cHi;
+    cv::v_expand(contourGlow, gcLo, gcHi);
+    cv::v_expand(contour, cLo, cHi);
+    return cv::v_pack(compositeLanes(edgeGlow[0], edgeMask[0], gw, lw, gcLo, cLo, halfCore[0]),
+                      compositeLanes(edgeGlow[1], edgeMask[1], gw, lw, gcHi, cHi, halfCore[1]));
+}
+#endif
+
+} // namespace
+
+std::vector<NeonGlow::Pass> NeonGlow::passes(int glowSize, int glowStrength) {
+    std::vector<Pass> result;
+    const int count = std::max(1, glowStrength);
+    for (int pass = 0; pass < count; ++pass) {
+        int blurSize = glowSize + pass * 10;
+        if (blurSize % 2 == 0) blurSize++;
+        result.push_back({blurSize, pass == 0 ? 1.0 : 0.5});
+    }
+    return result;
+}
+
+cv::Mat NeonGlow::gaussian(const cv::Mat& layer, const std::vector<Pass>& passes) {
+    cv::Mat glow = cv::Mat::zeros(layer.size(), layer.type());
+    for (const Pass& p : passes) {
+        cv::Mat blurred;
+        cv::GaussianBlur(layer, blurred, cv::Size(p.kernelSize, p.kernelSize), 0);
+        cv::addWeighted(glow, 1.0, blurred, p.weight, 0, glow);
+    }
+    return glow;
+}
+
+cv::Mat NeonGlow::pyramid(const cv::Mat& layer, const std::vector<Pass>& passes) {
+    if (layer.empty() || passes.empty()) {
+        return cv::Mat::zeros(layer.size(), layer.type());
+    }
+
+    // Coarsest level each pass can use: its remaining blur must still be at
+    // least one pixel of that level, and the level must not be tiny
+    const int minSide = std::min(layer.cols, layer.rows);
+    std::vector<int> passLevel(passes.size(), 0);
+    int topLevel = 0;
+    for (size_t i = 0; i < passes.size(); ++i) {
+        const double sigma = kernelSigma(passes[i].kernelSize);
+        int level = 0;
+        while (level < kMaxLevels &&
+               (minSide >> (level + 1)) >= 8 &&
+               sigma * sigma - pyramidVariance(level + 1) >= std::pow(4.0, level + 1)) {
+            level++;
+        }
+        passLevel[i] = level;
+        topLevel = std::max(topLevel, level);
+    }
+
+    std::vector<cv::Mat> levels(topLevel + 1);
+    levels[0] = layer;
+    for (int l = 1; l <= topLevel; ++l) {
+        cv::pyrDown(levels[l - 1], levels[l]);
+    }
+
+    // Blur each pass at its level and sum the passes that share a level
+    std::vector<cv::Mat> sums(topLevel + 1);
+    std::vector<cv::Mat> levelsF(topLevel + 1);
+    for (size_t i = 0; i < passes.size(); ++i) {
+        const int l = passLevel[i];
+        if (levelsF[l].empty()) {
+            levels[l].convertTo(levelsF[l], CV_32F);
+        }
+        const double sigma = kernelSigma(passes[i].kernelSize);
+        const double residual = std::sqrt(std::max(0.0, sigma * sigma - pyramidVariance(l))) / (1 << l);
+
+        cv::Mat blurred;
+        if (l == 0) {
+            // Full resolution: exactly what gaussian() does
+            cv::GaussianBlur(levelsF[l], blurred, cv::Size(passes[i].kernelSize, passes[i].kernelSize), 0);
+        } else {
+            cv::GaussianBlur(levelsF[l], blurred, cv::Size(0, 0), residual);
+        }
+        if (sums[l].empty()) {
+            sums[l] = blurred * passes[i].weight;
+        } else {
+            cv::scaleAdd(blurred, passes[i].weight, sums[l], sums[l]);
+        }
+    }
+
+    // One upsampling chain from the coarsest level back to full resolution
+    cv::Mat acc = sums[topLevel];
+    for (int l = topLevel - 1; l >= 0; --l) {
+        cv::Mat up;
+        cv::pyrUp(acc, up, levels[l].size());
+        if (!sums[l].empty()) {
+            up += sums[l];
+        }
+        acc = up;
+    }
+
+    cv::Mat glow;
+    acc.convertTo(glow, layer.type());
+    return glow;
+}
+
+void NeonGlow::composite(const cv::Mat& edgeGlow, const cv::Mat& edgeMask, const cv::Scalar& edgeColor,
+                         const cv::Mat& contourGlow, const cv::Mat& contours,
+                         const cv::Mat& core, cv::Mat& rgb) {
+    CV_Assert(edgeGlow.type() == CV_8UC1 && edgeMask.type() == CV_8UC1 &&
+              contourGlow.type() == CV_8UC3 && contours.type() == CV_8UC3);
+    const bool hasCore = !core.empty();
+    const int width = contours.cols;
+    const EdgeWeights weights = edgeWeights(edgeColor);
+    rgb.create(contours.size(), CV_8UC3);
+
+    cv::parallel_for_(cv::Range(0, contours.rows), [&](const cv::Range& rows) {
+        // Stands in for the core layer when there is none
+        std::vector<uint8_t> noCore(hasCore ? 0 : static_cast<size_t>(width), 0);
+        for (int y = rows.start; y < rows.end; ++y) {
+            const uint8_t* eg = edgeGlow.ptr<uint8_t>(y);
+            const uint8_t* em = edgeMask.ptr<uint8_t>(y);
+            const uint8_t* cg = contourGlow.ptr<uint8_t>(y);
+            const uint8_t* c = contours.ptr<uint8_t>(y);
+            const uint8_t* w = hasCore ? core.ptr<uint8_t>(y) : noCore.data();
+            uint8_t* dst = rgb.ptr<uint8_t>(y);
+
+            int x = 0;
+#if CV_SIMD128
+            for (; x + 16 <= width; x += 16) {
+                cv::v_uint16x8 egLanes[2], emLanes[2], coreLanes[2];
+                cv::v_expand(cv::v_load(eg + x), egLanes[0], egLanes[1]);
+                cv::v_expand(cv::v_load(em + x), emLanes[0], emLanes[1]);
+                cv::v_expand(cv::v_load(w + x), coreLanes[0], coreLanes[1]);
+                for (cv::v_uint16x8& lanes : coreLanes) {
+                    lanes = cv::v_shr<1>(cv::v_add(lanes, cv::v_setall_u16(1)));
+                }
+
+                const int i = x * 3;
+                cv::v_uint8x16 cgB, cgG, cgR, cB, cG, cR;
+                cv::v_load_deinterleave(cg + i, cgB, cgG, cgR);
+                cv::v_load_deinterleave(c + i, cB, cG, cR);
+                cv::v_store_interleave(dst + i,
+                    compositeChannel(egLanes, emLanes, weights.glow[2], weights.line[2], cgR, cR, coreLanes),
+                    compositeChannel(egLanes, emLanes, weights.glow[1], weights.line[1], cgG, cG, coreLanes),
+                    compositeChannel(egLanes, emLanes, weights.glow[0], weights.line[0], cgB, cB, coreLanes));
+            }
+#endif
+            for (; x < width; ++x) {
+                const int i = x * 3;
+                for (int ch = 0; ch < 3; ++ch) {
+                    // BGR in, RGB out
+                    dst[i + 2 - ch] = compositePixel(eg[x], em[x], weights.glow[ch], weights.line[ch],
+                                                     cg[i + ch], c[i + ch], w[x]);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,214 @@
+#include "ProcessingWorker.h"
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+ProcessingWorker::ProcessingWorker() {
+    // The UI process has cores to spare for overlapping the gradients
+    processor.setAsyncGradients(true);
+    proxy.setAsyncGradients(true);
+    thread = std::thread(&ProcessingWorker::run, this);
+}
+
+ProcessingWorker::~ProcessingWorker() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+        cancel.store(true);
+    }
+    queueCond.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+bool ProcessingWorker::loadImage(const std::string& filepath) {
+    // Stop whatever the worker is doing at the next stage boundary
+    cancel.store(true);
+
+    std::lock_guard<std::mutex> lock(processorMutex);
+
+    // Keyed by the file's bytes and the parameters of the last full run,
+    // which are the ones this image is processed with
+    uint64_t inputHash = 0;
+    loadKeyed = resultCache && ResultCache::hashFile(filepath, inputHash);
+    loadedStages = 0;
+    ProcessingResult cached;
+    if (loadKeyed) {
+        loadKey = ResultCache::makeKey(inputHash, processor.getParams());
+        if (resultCache->load(loadKey, cached)) {
+            loadedStages = cached.stages;
+            processor.setResult(std::move(cached));
+        }
+    }
+    if (loadedStages == 0 && !processor.loadImage(filepath)) {
+        loadKeyed = false;
+        return false;
+    }
+    proxyImageScale = 0.0;
+
+    // Show the image (and any cached stages) now; the rest is computed on
+    // the worker like any other snapshot
+    publish(processor.getResult(), 1.0f);
+    {
+        std::lock_guard<std::mutex> queueLock(queueMutex);
+        if (!hasPending) {
+            pendingParams = processor.getParams();
+        }
+        pendingPreview = false;
+        hasPending = true;
+        busy.store(true);
+    }
+    queueCond.notify_one();
+    return true;
+}
+
+void ProcessingWorker::setResultCache(std::unique_ptr<ResultCache> cache) {
+    std::lock_guard<std::mutex> lock(processorMutex);
+    resultCache = std::move(cache);
+}
+
+void ProcessingWorker::submit(const ImageProcessor::Params& params, bool preview) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        pendingParams = params;
+        pendingPreview = preview;
+        hasPending = true;
+        busy.store(true);
+        // A newer snapshot supersedes whatever is in flight
+        cancel.store(true);
+    }
+    queueCond.notify_one();
+}
+
+void ProcessingWorker::setOutputs(unsigned stages) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (stages == outputs) {
+            return;
+        }
+        outputs = stages;
+        if (!hasImage()) {
+            return;
+        }
+        // Rerun the latest snapshot at full resolution; stages that are
+        // already up to date cost nothing
+        pendingPreview = false;
+        hasPending = true;
+        busy.store(true);
+        cancel.store(true);
+    }
+    queueCond.notify_one();
+}
+
+bool ProcessingWorker::pollResult() {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    if (!hasReady) {
+        return false;
+    }
+    std::swap(front, ready);
+    hasReady = false;
+    return true;
+}
+
+void ProcessingWorker::run() {
+    while (true) {
+        ImageProcessor::Params params;
+        bool preview = false;
+        unsigned stages = 0;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCond.wait(lock, [this] { return stopping || hasPending; });
+            if (stopping) {
+                break;
+            }
+            params = pendingParams;
+            preview = pendingPreview;
+            stages = outputs;
+            hasPending = false;
+            cancel.store(false);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(processorMutex);
+            if (preview) {
+                runPreview(params, stages);
+            } else {
+                processor.setParams(params);
+                // Cancelled runs keep their remaining stages dirty, so the next
+                // snapshot picks up where this one stopped.
+                if (processor.processStages(stages, &cancel)) {
+                    publish(processor.getResult(), 1.0f);
+                    storeLoaded(params);
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (!hasPending) {
+                busy.store(false);
+            }
+        }
+    }
+}
+
+void ProcessingWorker::runPreview(const ImageProcessor::Params& params, unsigned stages) {
+    if (!processor.hasImage()) {
+        return;
+    }
+    if (proxyImageScale != proxyScale) {
+        cv::Mat small;
+        cv::resize(processor.getOriginalImage(), small, cv::Size(), proxyScale, proxyScale, cv::INTER_AREA);
+        proxy.setImage(small);
+        proxyImageScale = proxyScale;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    proxy.setParams(ImageProcessor::scaleParams(params, proxyImageScale));
+    if (!proxy.processStages(stages, &cancel)) {
+        return;
+    }
+    publish(proxy.getResult(), static_cast<float>(proxyImageScale));
+
+    // Keep previews around a frame or two: drop to 1/4 when 1/2 is slow,
+    // go back up when 1/4 has plenty of headroom
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (proxyScale > 0.25 && ms > 40.0) {
+        proxyScale = 0.25;
+    } else if (proxyScale < 0.5 && ms < 5.0) {
+        proxyScale = 0.5;
+    }
+}
+
+void ProcessingWorker::storeLoaded(const ImageProcessor::Params& params) {
+    // Only the first completed full-resolution run of a loaded image is
+    // cached. It may have run with newer parameters than the load looked up.
+    if (!loadKeyed) {
+        return;
+    }
+    loadKeyed = false;
+    const ResultCache::Key key = ResultCache::makeKey(loadKey.input, params);
+    if (key.params != loadKey.params || (processor.getResult().stages & ~loadedStages) != 0) {
+        resultCache->store(key, processor.getResult());
+    }
+}
+
+void ProcessingWorker::publish(const ProcessingResult& r, float scale) {
+    // The processor writes its Mats in place on the next run, so take a deep
+    // copy. Always into new allocations: once published, pixels are never
+    // written again, so the UI can hand them to ExportQueue without a copy.
+    back.originalImage = r.originalImage.clone();
+    back.edgeImage = r.edgeImage.clone();
+    back.brushStrokeImage = r.brushStrokeImage.clone();
+    back.neonImage = r.neonImage.clone();
+    back.contours = r.contours;
+    // Results alternate between two processors, so number them here
+    back.generation = ++published;
+    back.stages = r.stages;
+    back.scale = scale;
+
+    std::lock_guard<std::mutex> lock(resultMutex);
+    std::swap(back, ready);
+    hasReady = true;
+}
@@ -2,8 +2,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <algorithm>
-#include <cmath>
+#include <cstring>
 #include <iostream>
 
 const char* vertexShaderSource = R"(
@@ -32,7 +31,7 @@ void main() {
 )";
 
 Renderer::Renderer()
-    : VAO(0), VBO(0), EBO(0), shaderProgram(0), textureID(0), 
+    : VAO(0), VBO(0), EBO(0), shaderProgram(0),
       displayMode(ORIGINAL) {
 }
 
@@ -41,7 +40,10 @@ Renderer::~Renderer() {
     if (VBO != 0) glDeleteBuffers(1, &VBO);
     if (EBO != 0) glDeleteBuffers(1, &EBO);
     if (shaderProgram != 0) glDeleteProgram(shaderProgram);
-    if (textureID != 0) glDeleteTextures(1, &textureID);
+    for (ModeTexture& texture : textures) {
+        if (texture.id != 0) glDeleteTextures(1, &texture.id);
+        if (texture.pbo != 0) glDeleteBuffers(1, &texture.pbo);
+    }
 }
 
 void Renderer::init() {
@@ -94,13 +96,14 @@ void Renderer::createShaders() {
 }
 
 void Renderer::setupQuad() {
-    // Quad vertices with texture coordinates
+    // Quad vertices with texture coordinates. Textures hold OpenCV's
+    // top-down rows, so t = 0 is the top of the image.
     float vertices[] = {
         // positions          // texture coords
-        -1.0f,  1.0f, 0.0f,  0.0f, 1.0f,
-        -1.0f, -1.0f, 0.0f,  0.0f, 0.0f,
-         1.0f, -1.0f, 0.0f,  1.0f, 0.0f,
-         1.0f,  1.0f, 0.0f,  1.0f, 1.0f
+        -1.0f,  1.0f, 0.0f,  0.0f, 0.0f,
+        -1.0f, -1.0f, 0.0f,  0.0f, 1.0f,
+         1.0f, -1.0f, 0.0f,  1.0f, 1.0f,
+         1.0f,  1.0f, 0.0f,  1.0f, 0.0f
     };
 
     unsigned int indices[] = {
@@ -132,130 +135,98 @@ void Renderer::setupQuad() {
     glBindVertexArray(0);
 }
 
-GLuint Renderer::loadTexture(const cv::Mat& image) {
-    if (image.empty()) {
-        return 0;
+void Renderer::upload(ModeTexture& texture, const cv::Mat& image, uint64_t version) {
+    if (image.depth() != CV_8U || image.channels() == 2 || image.channels() > 4) {
+        std::cerr << "Unsupported image format for display: " << image.type() << std::endl;
+        return;
     }
 
-    cv::Mat displayImage = image.clone();
-
-    // Flip image vertically for OpenGL (OpenCV has origin at top-left, OpenGL at bottom-left)
-    cv::flip(displayImage, displayImage, 0);
-
-    // Ensure we have 3 or 4 channels
-    if (displayImage.channels() == 1) {
-        cv::cvtColor(displayImage, displayImage, cv::COLOR_GRAY2RGB);
-    } else if (displayImage.channels() == 4) {
-        cv::cvtColor(displayImage, displayImage, cv::COLOR_RGBA2RGB);
+    // Pixels go up in their own layout: one byte per pixel stays one byte
+    // and the swizzle expands it when sampling. Rows stay top-down; the
+    // texture coordinates flip them.
+    const int channels = image.channels();
+    const int width = image.cols;
+    const int height = image.rows;
+    const size_t rowBytes = static_cast<size_t>(width) * channels;
+    const GLsizeiptr bytes = static_cast<GLsizeiptr>(rowBytes * height);
+
+    // Storage is (re)allocated only when the size or layout changes; every
+    // other upload goes through glTexSubImage2D
+    if (texture.id == 0) {
+        glGenTextures(1, &texture.id);
+        glBindTexture(GL_TEXTURE_2D, texture.id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenBuffers(1, &texture.pbo);
     }
+    glBindTexture(GL_TEXTURE_2D, texture.id);
 
-    GLuint tex;
-    glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    const GLenum format = channels == 1 ? GL_RED : channels == 3 ? GL_RGB : GL_RGBA;
+    if (texture.width != width || texture.height != height || texture.channels != channels) {
+        const GLint internalFormat = channels == 1 ? GL_R8 : channels == 3 ? GL_RGB8 : GL_RGBA8;
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, displayImage.cols, displayImage.rows,
-                 0, GL_RGB, GL_UNSIGNED_BYTE, displayImage.data);
+        // Gray shows as gray and alpha is ignored, as with the old RGB uploads
+        const GLint gray[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        const GLint color[4] = {GL_RED, GL_GREEN, GL_BLUE, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, channels == 1 ? gray : color);
 
-    return tex;
-}
+        texture.width = width;
+        texture.height = height;
+        texture.channels = channels;
+    }
 
-void Renderer::renderImage(const cv::Mat& image) {
-    if (image.empty()) {
+    // Re-specifying the store first (orphaning) means mapping never has to
+    // wait for a previous glTexSubImage2D still reading the old store: the
+    // driver hands back fresh memory. The copy from the PBO into the
+    // texture is then queued like any other GL command, so this call does
+    // not wait for it either. (Whether a given driver really avoids the
+    // stall has not been measured.)
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texture.pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    uint8_t* dst = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (dst == nullptr) {
+        std::cerr << "Failed to map texture upload buffer" << std::endl;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
         return;
     }
-
-    if (textureID != 0) {
-        glDeleteTextures(1, &textureID);
+    if (image.isContinuous()) {
+        std::memcpy(dst, image.data, static_cast<size_t>(bytes));
+    } else {
+        for (int y = 0; y < height; ++y) {
+            std::memcpy(dst + rowBytes * y, image.ptr<uint8_t>(y), rowBytes);
+        }
     }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // Rows are tightly packed; tell GL the widest alignment they satisfy
+    const GLint alignment = rowBytes % 8 == 0 ? 8 : rowBytes % 4 == 0 ? 4 : rowBytes % 2 == 0 ? 2 : 1;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-    textureID = loadTexture(image);
+    texture.loaded = true;
+    texture.version = version;
+}
 
+void Renderer::draw() {
     glUseProgram(shaderProgram);
     glBindVertexArray(VAO);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    glBindTexture(GL_TEXTURE_2D, textures[displayMode].id);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 }
 
-void Renderer::renderEdges(const cv::Mat& edgeImage) {
-    if (edgeImage.empty()) {
-        return;
-    }
-
-    // Convert grayscale edges to 3-channel for display
-    cv::Mat displayImage;
-    cv::cvtColor(edgeImage, displayImage, cv::COLOR_GRAY2RGB);
-
-    renderImage(displayImage);
-}
-
-void Renderer::renderContours(const cv::Mat& image, const std::vector<std::vector<cv::Point>>& contours) {
+void Renderer::renderImage(const cv::Mat& image, uint64_t version) {
     if (image.empty()) {
         return;
     }
 
-    cv::Mat displayImage = image.clone();
-
-    auto hsvToRgb = [](float hDeg, float s, float v) -> cv::Scalar {
-        hDeg = std::fmod(hDeg, 360.0f);
-        if (hDeg < 0.0f) hDeg += 360.0f;
-        s = std::clamp(s, 0.0f, 1.0f);
-        v = std::clamp(v, 0.0f, 1.0f);
-
-        float c = v * s;
-        float x = c * (1.0f - std::fabs(std::fmod(hDeg / 60.0f, 2.0f) - 1.0f));
-        float m = v - c;
-
-        float r1 = 0.0f, g1 = 0.0f, b1 = 0.0f;
-        if (hDeg < 60.0f) {
-            r1 = c;
-            g1 = x;
-            b1 = 0.0f;
-        } else if (hDeg < 120.0f) {
-            r1 = x;
-            g1 = c;
-            b1 = 0.0f;
-        } else if (hDeg < 180.0f) {
-            r1 = 0.0f;
-            g1 = c;
-            b1 = x;
-        } else if (hDeg < 240.0f) {
-            r1 = 0.0f;
-            g1 = x;
-            b1 = c;
-        } else if (hDeg < 300.0f) {
-            r1 = x;
-            g1 = 0.0f;
-            b1 = c;
-        } else {
-            r1 = c;
-            g1 = 0.0f;
-            b1 = x;
-        }
-
-        uint8_t r = static_cast<uint8_t>(std::round((r1 + m) * 255.0f));
-        uint8_t g = static_cast<uint8_t>(std::round((g1 + m) * 255.0f));
-        uint8_t b = static_cast<uint8_t>(std::round((b1 + m) * 255.0f));
-        return cv::Scalar(r, g, b);
-    };
-
-    const int thickness = std::max(1, static_cast<int>(strokeWidth));
-    for (size_t i = 0; i < contours.size(); ++i) {
-        float hue = std::fmod(137.508f * static_cast<float>(i), 360.0f);
-        cv::Scalar color = hsvToRgb(hue, 0.95f, 1.0f);
-        cv::drawContours(displayImage, contours, static_cast<int>(i), color, thickness, cv::LINE_AA);
+    ModeTexture& texture = textures[displayMode];
+    if (!texture.loaded || texture.version != version) {
+        upload(texture, image, version);
     }
-
-    renderImage(displayImage);
-}
-
-void Renderer::setStrokeColor(float r, float g, float b, float a) {
-    strokeColor[0] = r;
-    strokeColor[1] = g;
-    strokeColor[2] = b;
-    strokeColor[3] = a;
+    draw();
 }
@@ -0,0 +1,468 @@
+#include "ResultCache.h"
+#include "CounterRng.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <vector>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Bump whenever the file layout or anything that changes the pipeline's
+// output for the same parameters does, so old entries stop matching
+constexpr uint32_t kFormatVersion = 2;
+constexpr char kMagic[4] = {'N', 'B', 'Z', 'C'};
+constexpr const char* kEntryExtension = ".nbc";
+
+// Eviction goes below the limit by this much so it does not rescan the
+// directory on every store once the cache is full
+constexpr double kEvictTarget = 0.75;
+
+// Entry layout, native byte order, every section 8-byte aligned:
+//   FileHeader
+//   4 x (MatHeader, rows * cols * elemSize bytes, padding): original, edges,
+//       brush strokes, neon (0 x 0 when the stage was not stored)
+//   uint64_t offsets[contourCount + 1]
+//   cv::Point points[pointCount]
+//   StoredFeatures features[contourCount]
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t input;
+    uint64_t params;
+    uint32_t stages;
+    uint32_t reserved;
+    uint64_t contourCount;
+    uint64_t pointCount;
+    uint64_t payloadHash;   // hashBytes() of everything after the header
+};
+
+struct MatHeader {
+    int32_t rows;
+    int32_t cols;
+    int32_t type;
+    int32_t reserved;
+};
+
+struct StoredFeatures {
+    double area;
+    double length;
+    int32_t bbox[4];
+    float centroid[2];
+};
+
+size_t padTo8(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+// Sequential reads out of the mapping, with bounds checks
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : p(data), left(size) {}
+
+    const uint8_t* take(size_t n) {
+        if (n > left) {
+            return nullptr;
+        }
+        const uint8_t* at = p;
+        const size_t step = std::min(padTo8(n), left);
+        p += step;
+        left -= step;
+        return at;
+    }
+
+    template <typename T>
+    bool read(T& value) {
+        const uint8_t* at = take(sizeof(T));
+        if (!at) return false;
+        std::memcpy(&value, at, sizeof(T));
+        return true;
+    }
+
+private:
+    const uint8_t* p;
+    size_t left;
+};
+
+bool readMat(Reader& reader, cv::Mat& mat) {
+    MatHeader header;
+    if (!reader.read(header)) {
+        return false;
+    }
+    if (header.rows == 0 || header.cols == 0) {
+        mat.release();
+        return true;
+    }
+    const int type = header.type;
+    if (header.rows < 0 || header.cols < 0 ||
+        (type != CV_8UC1 && type != CV_8UC3 && type != CV_8UC4)) {
+        return false;
+    }
+    const size_t bytes = static_cast<size_t>(header.rows) * static_cast<size_t>(header.cols) *
+                         static_cast<size_t>(CV_ELEM_SIZE(type));
+    const uint8_t* data = reader.take(bytes);
+    if (!data) {
+        return false;
+    }
+    // The pipeline writes its Mats in place later, so copy out of the mapping
+    cv::Mat(header.rows, header.cols, type, const_cast<uint8_t*>(data)).copyTo(mat);
+    return true;
+}
+
+bool readContours(Reader& reader, const FileHeader& header, ContourSet& contours) {
+    contours.clear();
+    const uint64_t count = header.contourCount;
+    const uint64_t pointCount = header.pointCount;
+    if (count > (1ull << 32) || pointCount > (1ull << 40)) {
+        return false;
+    }
+    const uint8_t* offsets = reader.take((count + 1) * sizeof(uint64_t));
+    const uint8_t* points = reader.take(pointCount * sizeof(cv::Point));
+    const uint8_t* features = reader.take(count * sizeof(StoredFeatures));
+    if (!offsets || !points || !features) {
+        return false;
+    }
+
+    contours.reserve(count, pointCount);
+    uint64_t begin = 0;
+    std::memcpy(&begin, offsets, sizeof(begin));
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t end = 0;
+        std::memcpy(&end, offsets + (i + 1) * sizeof(uint64_t), sizeof(end));
+        if (end < begin || end > pointCount) {
+            return false;
+        }
+        StoredFeatures stored;
+        std::memcpy(&stored, features + i * sizeof(StoredFeatures), sizeof(stored));
+        ContourSet::Features f;
+        f.area = stored.area;
+        f.length = stored.length;
+        f.bbox = cv::Rect(stored.bbox[0], stored.bbox[1], stored.bbox[2], stored.bbox[3]);
+        f.centroid = cv::Point2f(stored.centroid[0], stored.centroid[1]);
+        // Sections are 8-byte aligned, so the points can be read in place
+        const cv::Point* first = reinterpret_cast<const cv::Point*>(points) + begin;
+        contours.add(ContourSet::View(first, static_cast<size_t>(end - begin)), f);
+        begin = end;
+    }
+    return true;
+}
+
+void writePadding(std::ofstream& out, size_t written) {
+    static const char zeros[8] = {};
+    out.write(zeros, static_cast<std::streamsize>(padTo8(written) - written));
+}
+
+void writeMat(std::ofstream& out, const cv::Mat& mat) {
+    MatHeader header{};
+    if (!mat.empty()) {
+        header.rows = mat.rows;
+        header.cols = mat.cols;
+        header.type = mat.type();
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (mat.empty()) {
+        return;
+    }
+    const size_t rowBytes = static_cast<size_t>(mat.cols) * mat.elemSize();
+    for (int y = 0; y < mat.rows; ++y) {
+        out.write(reinterpret_cast<const char*>(mat.ptr(y)), static_cast<std::streamsize>(rowBytes));
+    }
+    writePadding(out, rowBytes * static_cast<size_t>(mat.rows));
+}
+
+void writeContours(std::ofstream& out, const ContourSet& contours) {
+    uint64_t offset = 0;
+    out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    for (size_t i = 0; i < contours.size(); ++i) {
+        offset += contours[i].size();
+        out.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    }
+    for (size_t i = 0; i < contours.size(); ++i) {
+        const ContourSet::View contour = contours[i];
+        out.write(reinterpret_cast<const char*>(contour.data()),
+                  static_cast<std::streamsize>(contour.size() * sizeof(cv::Point)));
+    }
+    for (size_t i = 0; i < contours.size(); ++i) {
+        const ContourSet::Features& f = contours.features(i);
+        StoredFeatures stored{};
+        stored.area = f.area;
+        stored.length = f.length;
+        stored.bbox[0] = f.bbox.x;
+        stored.bbox[1] = f.bbox.y;
+        stored.bbox[2] = f.bbox.width;
+        stored.bbox[3] = f.bbox.height;
+        stored.centroid[0] = f.centroid.x;
+        stored.centroid[1] = f.centroid.y;
+        out.write(reinterpret_cast<const char*>(&stored), sizeof(stored));
+    }
+}
+
+// 64-bit hash built from the SplitMix64 finalizer. Four independent lanes
+// keep the multiplies pipelined, so hashing runs far ahead of decoding.
+uint64_t hashBytes(const uint8_t* data, size_t size) {
+    uint64_t lanes[4] = {1, 2, 3, 4};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int l = 0; l < 4; ++l) {
+            uint64_t word;
+            std::memcpy(&word, data + i + 8 * l, sizeof(word));
+            lanes[l] = CounterRng::mix(lanes[l] ^ word);
+        }
+    }
+    // The last few words (the final one zero-padded) go to the lanes in order
+    for (int l = 0; i < size; i += 8, ++l) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, std::min<size_t>(size - i, 8));
+        lanes[l] = CounterRng::mix(lanes[l] ^ word);
+    }
+
+    uint64_t h = CounterRng::mix(static_cast<uint64_t>(size));
+    for (uint64_t lane : lanes) {
+        h = CounterRng::mix(h ^ lane);
+    }
+    return h;
+}
+
+std::string hex(uint64_t value) {
+    static const char digits[] = "0123456789abcdef";
+    std::string s(16, '0');
+    for (int i = 15; i >= 0; --i) {
+        s[i] = digits[value & 0xF];
+        value >>= 4;
+    }
+    return s;
+}
+
+int processId() {
+#ifdef _WIN32
+    return _getpid();
+#else
+    return static_cast<int>(::getpid());
+#endif
+}
+
+// Hash of the entry at `path` after its header
+bool hashPayload(const std::string& path, uint64_t& hash) {
+    MappedFile file;
+    if (!file.openRead(path) || file.size() < sizeof(FileHeader)) {
+        return false;
+    }
+    hash = hashBytes(file.data() + sizeof(FileHeader), file.size() - sizeof(FileHeader));
+    return true;
+}
+
+} // namespace
+
+ResultCache::ResultCache(const std::string& directory, uint64_t maxBytes)
+    : directory(directory), maxBytes(maxBytes) {
+    std::error_code ec;
+    fs::create_directories(directory, ec);
+    if (ec || !fs::is_directory(directory, ec)) {
+        std::cerr << "Failed to open result cache: " << directory << std::endl;
+        return;
+    }
+    open = true;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry : fs::directory_iterator(directory, ec)) {
+        if (entry.is_regular_file(ec) && entry.path().extension() == kEntryExtension) {
+            totalBytes += entry.file_size(ec);
+        }
+    }
+    if (totalBytes > maxBytes) {
+        evict();
+    }
+}
+
+bool ResultCache::hashFile(const std::string& filepath, uint64_t& hash) {
+    MappedFile file;
+    if (!file.openRead(filepath)) {
+        return false;
+    }
+    hash = hashBytes(file.data(), file.size());
+    return true;
+}
+
+ResultCache::Key ResultCache::makeKey(uint64_t inputHash, const ImageProcessor::Params& params) {
+    const std::string serialized = ImageProcessor::serializeParams(params);
+    Key key;
+    key.input = inputHash;
+    key.params = CounterRng::mix(hashBytes(reinterpret_cast<const uint8_t*>(serialized.data()),
+                                           serialized.size()) ^ kFormatVersion);
+    return key;
+}
+
+std::string ResultCache::entryPath(const Key& key) const {
+    return (fs::path(directory) / (hex(key.input) + "-" + hex(key.params) + kEntryExtension)).string();
+}
+
+bool ResultCache::load(const Key& key, ProcessingResult& result) {
+    if (!open) {
+        return false;
+    }
+    const std::string path = entryPath(key);
+    MappedFile file;
+    if (!file.openRead(path)) {
+        return false;
+    }
+
+    Reader reader(file.data(), file.size());
+    FileHeader header;
+    bool valid = reader.read(header) && std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+                 header.version == kFormatVersion && header.input == key.input &&
+                 header.params == key.params;
+    // Catches entries damaged on disk or by a writer that went wrong, which
+    // could otherwise pass the structural checks and serve bad pixels
+    valid = valid && hashBytes(file.data() + sizeof(FileHeader), file.size() - sizeof(FileHeader)) ==
+                         header.payloadHash;
+    valid = valid && readMat(reader, result.originalImage) && readMat(reader, result.edgeImage) &&
+            readMat(reader, result.brushStrokeImage) && readMat(reader, result.neonImage) &&
+            readContours(reader, header, result.contours) && !result.originalImage.empty();
+    file.close();
+
+    std::error_code ec;
+    if (!valid) {
+        std::cerr << "Discarding damaged cache entry: " << path << std::endl;
+        fs::remove(path, ec);
+        return false;
+    }
+    result.stages = header.stages & ImageProcessor::STAGE_ALL;
+    result.scale = 1.0f;
+
+    // Mark the entry as recently used
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void ResultCache::store(const Key& key, const ProcessingResult& result) {
+    if (!open || result.originalImage.empty() || result.scale != 1.0f) {
+        return;
+    }
+    const unsigned stages = result.stages & ImageProcessor::STAGE_ALL;
+    const bool withContours = (stages & ImageProcessor::STAGE_CONTOURS) != 0;
+
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kFormatVersion;
+    header.input = key.input;
+    header.params = key.params;
+    header.stages = stages;
+    if (withContours) {
+        header.contourCount = result.contours.size();
+        for (size_t i = 0; i < result.contours.size(); ++i) {
+            header.pointCount += result.contours[i].size();
+        }
+    }
+
+    const std::string path = entryPath(key);
+    // Unique across threads and across processes sharing the directory
+    std::string tempPath;
+    {
+        std::random_device rd;
+        std::ostringstream name;
+        name << path << "." << processId() << "-" << std::hex << rd() << rd() << ".tmp";
+        tempPath = name.str();
+    }
+
+    // Write to a temporary name and rename, so readers (other threads or
+    // processes) never map a half-written entry
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to write cache entry: " << tempPath << std::endl;
+            return;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        writeMat(out, result.originalImage);
+        writeMat(out, (stages & ImageProcessor::STAGE_EDGES) ? result.edgeImage : cv::Mat());
+        writeMat(out, (stages & ImageProcessor::STAGE_BRUSH) ? result.brushStrokeImage : cv::Mat());
+        writeMat(out, (stages & ImageProcessor::STAGE_NEON_COMPOSITE) ? result.neonImage : cv::Mat());
+        if (withContours) {
+            writeContours(out, result.contours);
+        } else {
+            writeContours(out, ContourSet());
+        }
+        if (!out) {
+            std::cerr << "Failed to write cache entry: " << tempPath << std::endl;
+            out.close();
+            std::error_code ec;
+            fs::remove(tempPath, ec);
+            return;
+        }
+    }
+
+    // Seal the entry with the hash of what actually reached the file
+    bool sealed = hashPayload(tempPath, header.payloadHash);
+    if (sealed) {
+        std::fstream out(tempPath, std::ios::binary | std::ios::in | std::ios::out);
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        sealed = static_cast<bool>(out);
+    }
+    std::error_code ec;
+    if (!sealed) {
+        std::cerr << "Failed to write cache entry: " << tempPath << std::endl;
+        fs::remove(tempPath, ec);
+        return;
+    }
+
+    const uint64_t size = fs::file_size(tempPath, ec);
+    const uint64_t replaced = fs::exists(path, ec) ? fs::file_size(path, ec) : 0;
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+        std::cerr << "Failed to write cache entry: " << path << std::endl;
+        fs::remove(tempPath, ec);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    totalBytes += size;
+    totalBytes -= std::min(replaced, totalBytes);
+    if (totalBytes > maxBytes) {
+        evict();
+    }
+}
+
+void ResultCache::evict() {
+    struct Entry {
+        fs::file_time_type used;
+        uint64_t size;
+        fs::path path;
+    };
+    std::vector<Entry> entries;
+    std::error_code ec;
+    totalBytes = 0;
+    for (const auto& entry : fs::directory_iterator(directory, ec)) {
+        if (!entry.is_regular_file(ec) || entry.path().extension() != kEntryExtension) {
+            continue;
+        }
+        Entry e{entry.last_write_time(ec), entry.file_size(ec), entry.path()};
+        totalBytes += e.size;
+        entries.push_back(std::move(e));
+    }
+
+    // Oldest use first
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.used < b.used;
+    });
+    const uint64_t target = static_cast<uint64_t>(static_cast<double>(maxBytes) * kEvictTarget);
+    for (const Entry& e : entries) {
+        if (totalBytes <= target) {
+            break;
+        }
+        if (fs::remove(e.path, ec)) {
+            totalBytes -= std::min(e.size, totalBytes);
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#include "StrokeRasterizer.h"
+#include <opencv2/core/hal/intrin.hpp>
+#include <algorithm>
+#include <cmath>
+
+void StrokeRasterizer::begin(cv::Size size) {
+    // Reuse the allocation between runs
+    target.create(size, CV_8UC1);
+    target.setTo(cv::Scalar(0));
+}
+
+void StrokeRasterizer::draw(cv::Point2f p1, cv::Point2f p2, int gray, int thickness) {
+    const float dx = p2.x - p1.x;
+    const float dy = p2.y - p1.y;
+    const float length = std::sqrt(dx * dx + dy * dy);
+    thickness = std::clamp(thickness, 1, kMaxThickness);
+    gray = std::clamp(gray, 0, 255);
+
+    // Lines are symmetric under a half turn, so fold the angle into [0, pi)
+    float angle = std::atan2(dy, dx);
+    if (angle < 0.0f) angle += static_cast<float>(CV_PI);
+    if (angle >= static_cast<float>(CV_PI)) angle -= static_cast<float>(CV_PI);
+    const int angleBin = static_cast<int>(std::lround(angle / CV_PI * kAngleBins)) % kAngleBins;
+
+    // Long strokes are laid down as equal pieces, each a cached stamp
+    const int pieces = std::max(1, static_cast<int>(std::ceil(length / kMaxLength)));
+    const int pieceLength = static_cast<int>(std::lround(length / pieces));
+    const Stamp& s = stamp(angleBin, pieceLength, thickness);
+    for (int i = 0; i < pieces; ++i) {
+        const float t = (i + 0.5f) / pieces;
+        blit(s, cv::Point2f(p1.x + dx * t, p1.y + dy * t), gray);
+    }
+}
+
+const StrokeRasterizer::Stamp& StrokeRasterizer::stamp(int angleBin, int length, int thickness) {
+    const uint32_t key = (static_cast<uint32_t>(angleBin) << 16) |
+                         (static_cast<uint32_t>(length) << 8) |
+                         static_cast<uint32_t>(thickness);
+    auto it = atlas.find(key);
+    if (it != atlas.end()) {
+        return it->second;
+    }
+    if (atlas.size() >= kMaxStamps) {
+        atlas.clear();
+    }
+
+    // Render the stroke centered in a tight box with cv::line's own
+    // anti-aliasing, using fractional endpoints (4 bits of subpixel shift)
+    const double angle = static_cast<double>(angleBin) * CV_PI / kAngleBins;
+    const double hx = 0.5 * length * std::cos(angle);
+    const double hy = 0.5 * length * std::sin(angle);
+    const int pad = thickness / 2 + 2;
+    const int w = static_cast<int>(std::ceil(2.0 * std::fabs(hx))) + 2 * pad + 1;
+    const int h = static_cast<int>(std::ceil(2.0 * std::fabs(hy))) + 2 * pad + 1;
+
+    Stamp s;
+    s.center = cv::Point2f(w * 0.5f, h * 0.5f);
+    s.coverage = cv::Mat::zeros(h, w, CV_8UC1);
+    const int shift = 4;
+    const double one = 1 << shift;
+    const cv::Point a(static_cast<int>(std::lround((s.center.x - hx) * one)),
+                      static_cast<int>(std::lround((s.center.y - hy) * one)));
+    const cv::Point b(static_cast<int>(std::lround((s.center.x + hx) * one)),
+                      static_cast<int>(std::lround((s.center.y + hy) * one)));
+    cv::line(s.coverage, a, b, cv::Scalar(255), thickness, cv::LINE_AA, shift);
+
+    return atlas.emplace(key, std::move(s)).first->second;
+}
+
+void StrokeRasterizer::blit(const Stamp& s, cv::Point2f midpoint, int gray) {
+    const int x0 = static_cast<int>(std::lround(midpoint.x - s.center.x));
+    const int y0 = static_cast<int>(std::lround(midpoint.y - s.center.y));
+
+    // Clip the stamp against the canvas
+    const cv::Rect dstRect = cv::Rect(x0, y0, s.coverage.cols, s.coverage.rows) & cv::Rect(0, 0, target.cols, target.rows);
+    if (dstRect.empty()) {
+        return;
+    }
+    const int sx = dstRect.x - x0;
+    const int sy = dstRect.y - y0;
+
+    // value = coverage * gray / 255, computed as (c * (gray + 1)) >> 8,
+    // which is exact at both ends of the range
+    const uint16_t scale = static_cast<uint16_t>(gray + 1);
+    for (int y = 0; y < dstRect.height; ++y) {
+        const uint8_t* src = s.coverage.ptr<uint8_t>(sy + y) + sx;
+        uint8_t* dst = target.ptr<uint8_t>(dstRect.y + y) + dstRect.x;
+        int x = 0;
+#if CV_SIMD128
+        const cv::v_uint16x8 vscale = cv::v_setall_u16(scale);
+        for (; x + 16 <= dstRect.width; x += 16) {
+            cv::v_uint16x8 lo, hi;
+            cv::v_expand(cv::v_load(src + x), lo, hi);
+            lo = cv::v_shr<8>(cv::v_mul_wrap(lo, vscale));
+            hi = cv::v_shr<8>(cv::v_mul_wrap(hi, vscale));
+            const cv::v_uint8x16 value = cv::v_pack(lo, hi);
+            cv::v_store(dst + x, cv::v_max(cv::v_load(dst + x), value));
+        }
+#endif
+        for (; x < dstRect.width; ++x) {
+            const uint8_t value = static_cast<uint8_t>((src[x] * scale) >> 8);
+            dst[x] = std::max(dst[x], value);
+        }
+    }
+}
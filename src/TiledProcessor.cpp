@@ -0,0 +1,458 @@
+#include "TiledProcessor.h"
+#include "MappedFile.h"
+#include "NeonGlow.h"
+#include <algorithm>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int oddSize(int k) {
+    return k % 2 == 0 ? k + 1 : k;
+}
+
+// Run fn(tileIndex, processor) for every tile on a pool of threads. Each
+// thread owns one ImageProcessor; they are not thread-safe.
+template <typename Fn>
+void forEachTile(size_t tileCount, int threads, const ImageProcessor::Params& params, Fn fn) {
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        ImageProcessor processor;
+        processor.setParams(params);
+        for (size_t i = next.fetch_add(1); i < tileCount; i = next.fetch_add(1)) {
+            fn(i, processor);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    for (auto& t : pool) {
+        t.join();
+    }
+}
+
+// Union-find over the sparse set of component ids that touch a tile border.
+// Ids not in the map are their own root; the smaller id always wins so the
+// result does not depend on merge order.
+class ComponentSets {
+public:
+    int find(int id) {
+        int root = id;
+        for (auto it = parent.find(root); it != parent.end() && it->second != root; it = parent.find(root)) {
+            root = it->second;
+        }
+        // Path compression
+        while (id != root) {
+            int& p = parent[id];
+            id = p;
+            p = root;
+        }
+        return root;
+    }
+
+    void unite(int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b) return;
+        if (b < a) std::swap(a, b);
+        parent[a] = a;
+        parent[b] = a;
+    }
+
+    // Final root of every id that was merged with something
+    std::unordered_map<int, int> roots() {
+        std::unordered_map<int, int> result;
+        result.reserve(parent.size());
+        std::vector<int> ids;
+        ids.reserve(parent.size());
+        for (const auto& kv : parent) {
+            ids.push_back(kv.first);
+        }
+        for (int id : ids) {
+            const int root = find(id);
+            if (root != id) {
+                result.emplace(id, root);
+            }
+        }
+        return result;
+    }
+
+private:
+    std::unordered_map<int, int> parent;
+};
+
+// Write connected components (labels from cv::connectedComponents over a
+// tile core) into the whole-image label map. A component's id is the raster
+// index (+1) of its first pixel, which is unique over the whole image
+// without any coordination between tiles. Components flagged in `negate`
+// are stored as -id.
+void writeGlobalLabels(const cv::Mat& local, int count, const cv::Rect& core, int width,
+                       const std::vector<uint8_t>& negate, cv::Mat target) {
+    std::vector<int> globalId(static_cast<size_t>(std::max(count, 1)), 0);
+    for (int y = 0; y < local.rows; ++y) {
+        const int* src = local.ptr<int>(y);
+        int* dst = target.ptr<int>(y);
+        for (int x = 0; x < local.cols; ++x) {
+            const int lbl = src[x];
+            if (lbl > 0 && globalId[lbl] == 0) {
+                const int id = (core.y + y) * width + (core.x + x) + 1;
+                globalId[lbl] = !negate.empty() && negate[lbl] ? -id : id;
+            }
+            dst[x] = lbl > 0 ? globalId[lbl] : 0;
+        }
+    }
+}
+
+// Merge components that touch across tile borders (8-connected). Ids are
+// compared by magnitude; the ids of negative labels seen on a border are
+// appended to `negative` if given.
+void uniteAcrossTiles(const cv::Mat& labels, int tileSize, ComponentSets& sets,
+                      std::vector<int>* negative = nullptr) {
+    auto visit = [&](int a, int b) {
+        if (negative && b < 0) negative->push_back(-b);
+        if (b != 0) sets.unite(std::abs(a), std::abs(b));
+    };
+    for (int x = tileSize; x < labels.cols; x += tileSize) {
+        for (int y = 0; y < labels.rows; ++y) {
+            const int a = labels.at<int>(y, x - 1);
+            if (a == 0) continue;
+            if (negative && a < 0) negative->push_back(-a);
+            for (int dy = -1; dy <= 1; ++dy) {
+                if (y + dy < 0 || y + dy >= labels.rows) continue;
+                visit(a, labels.at<int>(y + dy, x));
+            }
+        }
+    }
+    for (int y = tileSize; y < labels.rows; y += tileSize) {
+        for (int x = 0; x < labels.cols; ++x) {
+            const int a = labels.at<int>(y - 1, x);
+            if (a == 0) continue;
+            if (negative && a < 0) negative->push_back(-a);
+            for (int dx = -1; dx <= 1; ++dx) {
+                if (x + dx < 0 || x + dx >= labels.cols) continue;
+                visit(a, labels.at<int>(y, x + dx));
+            }
+        }
+    }
+}
+
+std::string scratchPath(const std::string& dir, const std::string& tag) {
+    std::random_device rd;
+    std::ostringstream name;
+    name << "neonbuzz-" << std::hex << rd() << "-" << tag << ".raw";
+    const fs::path base = dir.empty() ? fs::temp_directory_path() : fs::path(dir);
+    return (base / name.str()).string();
+}
+
+} // namespace
+
+TiledProcessor::TiledProcessor(const Options& options)
+    : options(options) {
+}
+
+int TiledProcessor::haloSize(const ImageProcessor::Params& p) {
+    // Radius over which detectEdges() reads its input
+    int edgeRadius = p.useBilateralFilter ? p.bilateralD / 2 : oddSize(std::max(1, p.blurStrength)) / 2;
+    edgeRadius += 2;  // Canny's Sobel and non-maximum suppression (hysteresis is global, see run())
+    if (p.morphologySize > 0) {
+        edgeRadius += 4 * (oddSize(p.morphologySize) / 2);  // Close + open
+    }
+    if (p.edgeDilation > 0) {
+        edgeRadius += oddSize(p.edgeDilation) / 2 + 8;  // Dilation plus some slack for thinning
+    }
+    if (p.edgeSmoothing > 0) {
+        edgeRadius += oddSize(p.edgeSmoothing) / 2;
+    }
+
+    // Radius over which the brush and neon stages read the edge map
+    const int densityRadius = std::max(1, p.edgeDensityKernel) / 2;
+    const int strokeReach = p.brushSize * 2 + 16;  // Edge strokes plus contour stroke overshoot
+    const int largestGlow = oddSize(p.neonGlowSize + (std::max(1, p.neonGlowStrength) - 1) * 10);
+    const int glowRadius = largestGlow / 2 + 3;     // Plus the contour line width
+    const int joinRadius = p.neonPerContour ? 0 : oddSize(std::max(3, p.neonJoinSize)) / 2;
+    const int stageRadius = std::max({densityRadius + strokeReach, glowRadius, joinRadius});
+
+    return edgeRadius + stageRadius;
+}
+
+bool TiledProcessor::run() {
+    const auto start = Clock::now();
+
+    // Decoding is the one step that holds the whole image in RAM (3 bytes per
+    // pixel); it is copied into a mapped scratch file and released right away.
+    cv::Mat decoded = cv::imread(options.inputPath, cv::IMREAD_COLOR);
+    if (decoded.empty()) {
+        std::cerr << "Failed to load image: " << options.inputPath << std::endl;
+        return false;
+    }
+    const int width = decoded.cols;
+    const int height = decoded.rows;
+    const size_t pixels = static_cast<size_t>(width) * static_cast<size_t>(height);
+    if (pixels >= 0x7FFFFFFFu) {
+        std::cerr << "Image too large for tiled processing: " << width << "x" << height << std::endl;
+        return false;
+    }
+
+    MappedFile inputFile, labelFile, cannyFile, outputFile;
+    if (!inputFile.open(scratchPath(options.scratchDir, "input"), pixels * 3) ||
+        !labelFile.open(scratchPath(options.scratchDir, "labels"), pixels * sizeof(int)) ||
+        !cannyFile.open(scratchPath(options.scratchDir, "canny"), pixels) ||
+        !outputFile.open(scratchPath(options.scratchDir, "output"), pixels * 3)) {
+        return false;
+    }
+    cv::Mat input(height, width, CV_8UC3, inputFile.data());
+    cv::Mat labels(height, width, CV_32S, labelFile.data());    // Candidate ids, then edge ids
+    cv::Mat canny(height, width, CV_8UC1, cannyFile.data());
+    cv::Mat output(height, width, CV_8UC3, outputFile.data());
+    decoded.copyTo(input);
+    decoded.release();
+
+    int tileSize = std::max(64, options.tileSize);
+    int halo = haloSize(options.params);
+    if (options.params.neonGlowBackend == ImageProcessor::GLOW_PYRAMID) {
+        // Tile origins (core - halo) on the pyramid's grid, so every tile
+        // downsamples the same pixels together as the whole image would
+        const int a = NeonGlow::kAlignment;
+        tileSize = (tileSize + a - 1) / a * a;
+        halo = (halo + a - 1) / a * a;
+    }
+    const cv::Rect bounds(0, 0, width, height);
+    std::vector<cv::Rect> tiles;
+    for (int y = 0; y < height; y += tileSize) {
+        for (int x = 0; x < width; x += tileSize) {
+            tiles.push_back(cv::Rect(x, y, tileSize, tileSize) & bounds);
+        }
+    }
+    auto withHalo = [&](const cv::Rect& core) {
+        return cv::Rect(core.x - halo, core.y - halo, core.width + 2 * halo, core.height + 2 * halo) & bounds;
+    };
+    auto loadTile = [&](const cv::Rect& outer) {
+        cv::Mat rgb;
+        cv::cvtColor(input(outer), rgb, cv::COLOR_BGR2RGB);
+        return rgb;
+    };
+
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const int threads = options.threads > 0 ? options.threads : static_cast<int>(cores);
+    std::cout << "[tiled] " << width << "x" << height << ", " << tiles.size() << " tiles of "
+              << tileSize << "px + " << halo << "px halo, " << threads << " threads" << std::endl;
+
+    // Tiles already run in parallel; nested OpenCV threading would only
+    // oversubscribe the cores.
+    const int previousCvThreads = cv::getNumThreads();
+    cv::setNumThreads(1);
+
+    // Pass 1: hysteresis over the whole image. It is not local: a weak
+    // candidate chain is an edge if any pixel of it is strong, however far
+    // away. Candidates are labelled per tile core, strong pieces stored with
+    // a negative id, and pieces are merged across tile borders; a merged
+    // component is strong if any piece is.
+    forEachTile(tiles.size(), threads, options.params, [&](size_t t, ImageProcessor& processor) {
+        const cv::Rect core = tiles[t];
+        const cv::Rect outer = withHalo(core);
+        const cv::Rect inner(core.tl() - outer.tl(), core.size());
+
+        processor.setImage(loadTile(outer));
+        cv::Mat classes;
+        processor.classifyEdgePixels(classes);
+        const cv::Mat coreClasses = classes(inner);
+
+        cv::Mat local;
+        const int count = cv::connectedComponents(coreClasses > 0, local, 8, CV_32S);
+        std::vector<uint8_t> strong(static_cast<size_t>(std::max(count, 1)), 0);
+        for (int y = 0; y < local.rows; ++y) {
+            const uint8_t* c = coreClasses.ptr<uint8_t>(y);
+            const int* l = local.ptr<int>(y);
+            for (int x = 0; x < local.cols; ++x) {
+                if (c[x] == 2) strong[l[x]] = 1;
+            }
+        }
+        writeGlobalLabels(local, count, core, width, strong, labels(core));
+    });
+    {
+        ComponentSets candidateSets;
+        std::vector<int> strongIds;
+        uniteAcrossTiles(labels, tileSize, candidateSets, &strongIds);
+        std::unordered_set<int> strongRoots;
+        for (int id : strongIds) {
+            strongRoots.insert(candidateSets.find(id));
+        }
+        const std::unordered_map<int, int> candidateRoots = candidateSets.roots();
+        forEachTile(tiles.size(), threads, options.params, [&](size_t t, ImageProcessor&) {
+            const cv::Mat src = labels(tiles[t]);
+            cv::Mat dst = canny(tiles[t]);
+            for (int y = 0; y < src.rows; ++y) {
+                const int* l = src.ptr<int>(y);
+                uint8_t* o = dst.ptr<uint8_t>(y);
+                for (int x = 0; x < src.cols; ++x) {
+                    bool edge = l[x] < 0;
+                    if (l[x] > 0) {
+                        auto it = candidateRoots.find(l[x]);
+                        edge = strongRoots.count(it != candidateRoots.end() ? it->second : l[x]) > 0;
+                    }
+                    o[x] = edge ? 255 : 0;
+                }
+            }
+        });
+    }
+    std::cout << "[tiled] Resolved hysteresis in " << secondsSince(start) << " s" << std::endl;
+
+    // Every later pass reads its tile's Canny output from the whole-image map
+    auto tileContextFor = [&](const cv::Rect& outer) {
+        ImageProcessor::TileContext tileContext;
+        tileContext.cannyEdges = canny(outer);
+        tileContext.origin = outer.tl();
+        tileContext.fullWidth = width;
+        return tileContext;
+    };
+
+    // Pass 2: edges per tile, labelled into connected components with
+    // whole-image ids
+    std::mutex statsMutex;
+    double densityMin = 255.0;
+    double densityMax = 0.0;
+    forEachTile(tiles.size(), threads, options.params, [&](size_t t, ImageProcessor& processor) {
+        const cv::Rect core = tiles[t];
+        const cv::Rect outer = withHalo(core);
+        const cv::Rect inner(core.tl() - outer.tl(), core.size());
+
+        processor.setTileContext(tileContextFor(outer));
+        processor.setImage(loadTile(outer));
+        processor.processStages(ImageProcessor::STAGE_EDGES);
+        const cv::Mat& edges = processor.getEdgeImage();
+
+        cv::Mat density;
+        const int k = std::max(1, options.params.edgeDensityKernel);
+        cv::blur(edges, density, cv::Size(k, k));
+        double lo, hi;
+        cv::minMaxLoc(density(inner), &lo, &hi);
+
+        cv::Mat local;
+        const int count = cv::connectedComponents(edges(inner), local, 8, CV_32S);
+        writeGlobalLabels(local, count, core, width, std::vector<uint8_t>(), labels(core));
+
+        std::lock_guard<std::mutex> lock(statsMutex);
+        densityMin = std::min(densityMin, lo);
+        densityMax = std::max(densityMax, hi);
+    });
+
+    ComponentSets sets;
+    uniteAcrossTiles(labels, tileSize, sets);
+    const std::unordered_map<int, int> roots = sets.roots();
+
+    // "Group Nearby" has to see every contour at once, or the same contour
+    // would be grouped (and colored) differently on either side of a border.
+    // Each global component stands in for its contours, at the mean of its
+    // edge pixels.
+    const ImageProcessor::Params& p = options.params;
+    const bool groupWhole = p.neonPerContour && p.neonKMeansEnabled &&
+                            (ImageProcessor::viewStages(options.displayMode) & ImageProcessor::STAGE_NEON);
+    struct PixelSum {
+        double x = 0.0;
+        double y = 0.0;
+        double count = 0.0;
+    };
+    std::unordered_map<int, PixelSum> componentSums;
+    if (!roots.empty() || groupWhole) {
+        forEachTile(tiles.size(), threads, options.params, [&](size_t t, ImageProcessor&) {
+            const cv::Rect core = tiles[t];
+            cv::Mat target = labels(core);
+            std::unordered_map<int, PixelSum> sums;
+            for (int y = 0; y < target.rows; ++y) {
+                int* row = target.ptr<int>(y);
+                for (int x = 0; x < target.cols; ++x) {
+                    if (row[x] == 0) continue;
+                    auto it = roots.find(row[x]);
+                    if (it != roots.end()) row[x] = it->second;
+                    if (groupWhole) {
+                        PixelSum& sum = sums[row[x]];
+                        sum.x += core.x + x;
+                        sum.y += core.y + y;
+                        sum.count += 1.0;
+                    }
+                }
+            }
+            if (groupWhole) {
+                std::lock_guard<std::mutex> lock(statsMutex);
+                for (const auto& kv : sums) {
+                    PixelSum& sum = componentSums[kv.first];
+                    sum.x += kv.second.x;
+                    sum.y += kv.second.y;
+                    sum.count += kv.second.count;
+                }
+            }
+        });
+    }
+    std::shared_ptr<const std::unordered_map<int, int>> contourColors;
+    if (groupWhole) {
+        std::vector<int> ids;
+        std::vector<cv::Point2f> centroids;
+        ids.reserve(componentSums.size());
+        centroids.reserve(componentSums.size());
+        for (const auto& kv : componentSums) {
+            ids.push_back(kv.first);
+            centroids.emplace_back(static_cast<float>(kv.second.x / kv.second.count),
+                                   static_cast<float>(kv.second.y / kv.second.count));
+        }
+        const std::vector<int> colors = ImageProcessor::groupContourColors(centroids, ids, p);
+        auto colorMap = std::make_shared<std::unordered_map<int, int>>();
+        colorMap->reserve(ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            colorMap->emplace(ids[i], colors[i]);
+        }
+        contourColors = colorMap;
+    }
+    std::cout << "[tiled] Labelled edges in " << secondsSince(start) << " s ("
+              << roots.size() << " components merged across tiles)" << std::endl;
+
+    // Pass 3: full pipeline per tile with whole-image labels and density
+    // range, keeping only the core of each result
+    forEachTile(tiles.size(), threads, options.params, [&](size_t t, ImageProcessor& processor) {
+        const cv::Rect core = tiles[t];
+        const cv::Rect outer = withHalo(core);
+        const cv::Rect inner(core.tl() - outer.tl(), core.size());
+
+        ImageProcessor::TileContext tileContext = tileContextFor(outer);
+        tileContext.contourLabels = labels(outer);
+        tileContext.densityMin = densityMin;
+        tileContext.densityMax = densityMax;
+        tileContext.contourColors = contourColors;
+        processor.setTileContext(tileContext);
+        processor.setImage(loadTile(outer));
+        processor.processStages(ImageProcessor::viewStages(options.displayMode));
+
+        cv::Mat view = ImageProcessor::composeView(processor.getResult(), options.displayMode);
+        cv::Mat bgr;
+        cv::cvtColor(view(inner), bgr, cv::COLOR_RGB2BGR);
+        bgr.copyTo(output(core));
+    });
+
+    cv::setNumThreads(previousCvThreads);
+
+    const bool written = cv::imwrite(options.outputPath, output);
+    if (!written) {
+        std::cerr << "Failed to save image: " << options.outputPath << std::endl;
+    }
+    std::cout << "[tiled] Wrote " << options.outputPath << " in " << secondsSince(start) << " s" << std::endl;
+    return written;
+}
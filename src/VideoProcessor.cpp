@@ -0,0 +1,203 @@
+#include "VideoProcessor.h"
+#include "SpscQueue.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Frame {
+    int64_t index = -1;
+    cv::Mat image;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int pickFourcc(const std::string& requested, const std::string& outputPath) {
+    if (requested.size() == 4) {
+        return cv::VideoWriter::fourcc(requested[0], requested[1], requested[2], requested[3]);
+    }
+    std::string ext = std::filesystem::path(outputPath).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (ext == ".avi") {
+        return cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+    }
+    return cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+}
+
+} // namespace
+
+VideoProcessor::VideoProcessor(const Options& options)
+    : options(options) {
+}
+
+bool VideoProcessor::run() {
+    cv::VideoCapture capture(options.inputPath);
+    if (!capture.isOpened()) {
+        std::cerr << "Failed to open video: " << options.inputPath << std::endl;
+        return false;
+    }
+    double fps = capture.get(cv::CAP_PROP_FPS);
+    if (fps <= 0.0) {
+        fps = 30.0;
+    }
+
+    // The writer needs the output size up front, so decode the first frame here
+    cv::Mat bgr;
+    if (!capture.read(bgr) || bgr.empty()) {
+        std::cerr << "No frames in video: " << options.inputPath << std::endl;
+        return false;
+    }
+    Frame firstFrame;
+    firstFrame.index = 0;
+    firstFrame.image = ImageProcessor::prepareImage(bgr);
+
+    cv::VideoWriter writer(options.outputPath, pickFourcc(options.fourcc, options.outputPath),
+                           fps, firstFrame.image.size(), true);
+    if (!writer.isOpened()) {
+        std::cerr << "Failed to open video writer: " << options.outputPath << std::endl;
+        return false;
+    }
+
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    // Temporal state only makes sense when one processor sees every frame
+    const int workers = options.temporal ? 1
+                      : options.threads > 0 ? options.threads : static_cast<int>(cores);
+
+    // Frames are already processed in parallel; nested OpenCV threading
+    // inside each worker would only oversubscribe the cores.
+    const int previousCvThreads = cv::getNumThreads();
+    if (workers > 1) {
+        cv::setNumThreads(1);
+    }
+
+    // One input and one output queue per worker keeps every queue SPSC
+    const size_t queueCapacity = 4;
+    std::vector<std::unique_ptr<SpscQueue<Frame>>> toWorker, fromWorker;
+    for (int i = 0; i < workers; ++i) {
+        toWorker.push_back(std::make_unique<SpscQueue<Frame>>(queueCapacity));
+        fromWorker.push_back(std::make_unique<SpscQueue<Frame>>(queueCapacity));
+    }
+
+    // Busy time per stage, each written by a single thread
+    double decodeSeconds = 0.0;
+    double encodeSeconds = 0.0;
+    std::vector<double> processSeconds(static_cast<size_t>(workers), 0.0);
+    const auto start = Clock::now();
+
+    std::thread decoder([&]() {
+        toWorker[0]->push(firstFrame);
+        for (int64_t index = 1;; ++index) {
+            const auto t0 = Clock::now();
+            if (!capture.read(bgr) || bgr.empty()) {
+                break;
+            }
+            Frame frame;
+            frame.index = index;
+            frame.image = ImageProcessor::prepareImage(bgr);
+            decodeSeconds += secondsSince(t0);
+            // Round-robin; the encoder restores the order
+            toWorker[static_cast<size_t>(index % workers)]->push(frame);
+        }
+        for (auto& q : toWorker) {
+            q->close();
+        }
+    });
+
+    std::vector<std::thread> processors;
+    for (int k = 0; k < workers; ++k) {
+        processors.emplace_back([&, k]() {
+            ImageProcessor processor;
+            processor.setParams(options.params);
+            processor.setTemporalCoherence(options.temporal);
+            Frame frame;
+            while (toWorker[k]->pop(frame)) {
+                const auto t0 = Clock::now();
+                processor.setImage(frame.image);
+                processor.processStages(ImageProcessor::viewStages(options.displayMode));
+                cv::Mat view = ImageProcessor::composeView(processor.getResult(), options.displayMode);
+                cv::cvtColor(view, view, cv::COLOR_RGB2BGR);
+                frame.image = view;
+                processSeconds[k] += secondsSince(t0);
+                fromWorker[k]->push(frame);
+            }
+            fromWorker[k]->close();
+        });
+    }
+
+    // Encode on this thread. Frames can finish out of order, so hold them
+    // until the next index in sequence is available. The loop drains every
+    // worker queue until it is closed; the workers and the decoder block in
+    // push() otherwise.
+    std::map<int64_t, cv::Mat> pending;
+    int64_t nextIndex = 0;
+    auto writeReady = [&](bool flush) {
+        while (!pending.empty() && (flush || pending.begin()->first == nextIndex)) {
+            const auto t0 = Clock::now();
+            writer.write(pending.begin()->second);
+            encodeSeconds += secondsSince(t0);
+            nextIndex = pending.begin()->first + 1;
+            pending.erase(pending.begin());
+        }
+    };
+
+    int spins = 0;
+    while (true) {
+        bool progressed = false;
+        bool allClosed = true;
+        for (auto& q : fromWorker) {
+            // Check closed before draining so nothing pushed earlier is missed
+            if (!q->isClosed()) {
+                allClosed = false;
+            }
+            Frame frame;
+            while (q->tryPop(frame)) {
+                pending.emplace(frame.index, std::move(frame.image));
+                progressed = true;
+            }
+        }
+        writeReady(false);
+        if (allClosed) {
+            writeReady(true);
+            break;
+        }
+        if (progressed) {
+            spins = 0;
+        } else {
+            spscBackoff(spins);
+        }
+    }
+
+    decoder.join();
+    for (auto& t : processors) {
+        t.join();
+    }
+    writer.release();
+    cv::setNumThreads(previousCvThreads);
+
+    const double seconds = secondsSince(start);
+    const double frames = static_cast<double>(std::max<int64_t>(nextIndex, 1));
+    double processTotal = 0.0;
+    for (double s : processSeconds) {
+        processTotal += s;
+    }
+    std::cout << "[video] Wrote " << nextIndex << " frames in " << seconds << " s ("
+              << nextIndex / std::max(seconds, 1e-6) << " fps, " << workers << " process threads"
+              << (options.temporal ? ", temporal" : "") << ")" << std::endl;
+    std::cout << "[video] Per frame: decode " << 1000.0 * decodeSeconds / frames
+              << " ms, process " << 1000.0 * processTotal / frames / workers
+              << " ms (per worker share), encode " << 1000.0 * encodeSeconds / frames << " ms" << std::endl;
+    return true;
+}
@@ -0,0 +1,119 @@
+#include "ViewCache.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+enum ViewMode { ORIGINAL, EDGES, CONTOURS, BRUSH_STROKES, COMBINED, NEON };
+
+cv::Scalar hsvToRgb(float hDeg, float s, float v) {
+    hDeg = std::fmod(hDeg, 360.0f);
+    if (hDeg < 0.0f) hDeg += 360.0f;
+    s = std::clamp(s, 0.0f, 1.0f);
+    v = std::clamp(v, 0.0f, 1.0f);
+
+    float c = v * s;
+    float x = c * (1.0f - std::fabs(std::fmod(hDeg / 60.0f, 2.0f) - 1.0f));
+    float m = v - c;
+
+    float r1 = 0.0f, g1 = 0.0f, b1 = 0.0f;
+    if (hDeg < 60.0f) {
+        r1 = c;
+        g1 = x;
+        b1 = 0.0f;
+    } else if (hDeg < 120.0f) {
+        r1 = x;
+        g1 = c;
+        b1 = 0.0f;
+    } else if (hDeg < 180.0f) {
+        r1 = 0.0f;
+        g1 = c;
+        b1 = x;
+    } else if (hDeg < 240.0f) {
+        r1 = 0.0f;
+        g1 = x;
+        b1 = c;
+    } else if (hDeg < 300.0f) {
+        r1 = x;
+        g1 = 0.0f;
+        b1 = c;
+    } else {
+        r1 = c;
+        g1 = 0.0f;
+        b1 = x;
+    }
+
+    uint8_t r = static_cast<uint8_t>(std::round((r1 + m) * 255.0f));
+    uint8_t g = static_cast<uint8_t>(std::round((g1 + m) * 255.0f));
+    uint8_t b = static_cast<uint8_t>(std::round((b1 + m) * 255.0f));
+    return cv::Scalar(r, g, b);
+}
+
+} // namespace
+
+const cv::Mat& ViewCache::view(const ProcessingResult& result, int displayMode, uint64_t* version) {
+    if (displayMode < 0 || displayMode >= kModeCount) {
+        displayMode = BRUSH_STROKES;
+    }
+
+    Entry& entry = entries[displayMode];
+    if (!entry.valid || entry.generation != result.generation) {
+        build(result, displayMode, entry);
+        entry.valid = true;
+        entry.generation = result.generation;
+        entry.version = ++versions;
+    }
+    if (version != nullptr) {
+        *version = entry.version;
+    }
+
+    switch (displayMode) {
+        case ORIGINAL:      return result.originalImage;
+        case EDGES:         return result.edgeImage;
+        case BRUSH_STROKES: return result.brushStrokeImage;
+        case NEON:          return result.neonImage;
+        default:            return entry.image;
+    }
+}
+
+void ViewCache::build(const ProcessingResult& result, int displayMode, Entry& entry) {
+    if (displayMode == CONTOURS) {
+        // Each contour in its own hue, spread by the golden angle
+        if (result.originalImage.empty()) {
+            entry.image.release();
+            return;
+        }
+        // A new buffer, as an export may still hold the previous one
+        entry.image = result.originalImage.clone();
+        const int thickness = std::max(1, static_cast<int>(strokeWidth));
+        for (size_t i = 0; i < result.contours.size(); ++i) {
+            float hue = std::fmod(137.508f * static_cast<float>(i), 360.0f);
+            result.contours.draw(entry.image, static_cast<int>(i), hsvToRgb(hue, 0.95f, 1.0f),
+                                 thickness, cv::LINE_AA);
+        }
+    } else if (displayMode == COMBINED) {
+        if (result.brushStrokeImage.empty()) {
+            entry.image.release();
+            return;
+        }
+        entry.image = result.brushStrokeImage.clone();
+        result.contours.draw(entry.image, -1, strokeColor, 1);
+    }
+}
+
+void ViewCache::setStrokeWidth(float width) {
+    if (width != strokeWidth) {
+        strokeWidth = width;
+        entries[CONTOURS].valid = false;
+    }
+}
+
+void ViewCache::setStrokeColor(float r, float g, float b) {
+    const cv::Scalar color(std::lround(std::clamp(r, 0.0f, 1.0f) * 255.0f),
+                           std::lround(std::clamp(g, 0.0f, 1.0f) * 255.0f),
+                           std::lround(std::clamp(b, 0.0f, 1.0f) * 255.0f));
+    if (color != strokeColor) {
+        strokeColor = color;
+        entries[COMBINED].valid = false;
+    }
+}
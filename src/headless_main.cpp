@@ -0,0 +1,14 @@
+#include "Headless.h"
+#include <exception>
+#include <iostream>
+
+// Entry point of NeonBuzzBatch, which links no GL, GLEW or ImGui
+int main(int argc, char* argv[]) {
+    try {
+        return runHeadless(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
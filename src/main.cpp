@@ -1,13 +1,40 @@
 #include "App.h"
+#include "Headless.h"
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
 int main(int argc, char* argv[]) {
     try {
+        // Headless modes never create a window, so they work on render nodes
+        if (argc > 1 && isHeadlessCommand(argv[1])) {
+            return runHeadless(argc, argv);
+        }
+
+        // NeonBuzz [image] [--cache <dir>] [--cache-size <MB>]
+        std::string imagePath;
+        std::string cacheDir;
+        int cacheSizeMB = 2048;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            if (arg == "--cache" && i + 1 < argc) {
+                cacheDir = argv[++i];
+            } else if (arg == "--cache-size" && i + 1 < argc) {
+                cacheSizeMB = std::atoi(argv[++i]);
+            } else if (imagePath.empty()) {
+                imagePath = arg;
+            }
+        }
+
         App app(1280, 720);
+        if (!cacheDir.empty()) {
+            app.setResultCache(cacheDir, static_cast<uint64_t>(cacheSizeMB > 0 ? cacheSizeMB : 1) << 20);
+        }
 
         // Load a sample image if provided as argument
-        if (argc > 1) {
-            app.loadImage(argv[1]);
+        if (!imagePath.empty()) {
+            app.loadImage(imagePath);
         }
 
         app.run();
@@ -0,0 +1,296 @@
+// Checks for the processing core, run by ctest. Each group is one test:
+//
+//   NeonBuzzTests batch           BatchProcessor in every display mode, with
+//                                 and without a result cache
+//   NeonBuzzTests result_cache    ResultCache round trip, damaged entries
+//                                 and least-recently-used eviction
+
+#include "BatchProcessor.h"
+#include "ImageProcessor.h"
+#include "ResultCache.h"
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond     \
+                      << std::endl;                                                  \
+            ++failures;                                                              \
+        }                                                                            \
+    } while (0)
+
+// Fresh directory under the system temp directory, removed on destruction
+class TempDir {
+public:
+    TempDir() {
+        std::random_device rd;
+        std::ostringstream name;
+        name << "neonbuzz-tests-" << std::hex << rd() << rd();
+        path = fs::temp_directory_path() / name.str();
+        fs::create_directories(path);
+    }
+    ~TempDir() {
+        std::error_code ec;
+        fs::remove_all(path, ec);
+    }
+
+    fs::path path;
+};
+
+// 3-channel test image with enough shapes for edges, several contours and strokes
+cv::Mat syntheticImage(int width, int height, int variant) {
+    cv::Mat image(height, width, CV_8UC3, cv::Scalar(30, 30, 30));
+    cv::rectangle(image, cv::Rect(width / 8, height / 8, width / 3, height / 4),
+                  cv::Scalar(40, 200, 220), cv::FILLED);
+    cv::circle(image, cv::Point(width * 2 / 3, height / 2), std::min(width, height) / 5 + variant * 4,
+               cv::Scalar(220, 60, 90), cv::FILLED);
+    cv::ellipse(image, cv::Point(width / 3, height * 3 / 4), cv::Size(width / 6, height / 10), 20.0 * variant,
+                0.0, 360.0, cv::Scalar(90, 230, 70), cv::FILLED);
+    cv::line(image, cv::Point(0, height - 1), cv::Point(width - 1, height / 3), cv::Scalar(250, 250, 250), 3);
+    return image;
+}
+
+std::vector<fs::path> filesIn(const fs::path& dir) {
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.is_regular_file(ec)) {
+            files.push_back(entry.path());
+        }
+    }
+    return files;
+}
+
+bool samePixels(const cv::Mat& a, const cv::Mat& b) {
+    if (a.empty() || b.empty()) {
+        return a.empty() && b.empty();
+    }
+    return a.size() == b.size() && a.type() == b.type() && cv::norm(a, b, cv::NORM_INF) == 0.0;
+}
+
+bool sameContours(const ContourSet& a, const ContourSet& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        const ContourSet::View va = a[i];
+        const ContourSet::View vb = b[i];
+        if (va.size() != vb.size()) {
+            return false;
+        }
+        for (size_t j = 0; j < va.size(); ++j) {
+            if (va[j] != vb[j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Runs a batch for one display mode and checks that every input produced a
+// decodable output. Returns the decoded outputs, sorted by file name.
+std::vector<cv::Mat> runBatch(const fs::path& input, const fs::path& output, int mode,
+                              const std::string& cacheDir, size_t inputs) {
+    BatchProcessor::Options options;
+    options.inputDir = input.string();
+    options.outputDir = output.string();
+    options.displayMode = mode;
+    options.threads = 2;
+    options.cacheDir = cacheDir;
+    options.params.seed = 7;
+
+    BatchProcessor batch(options);
+    const int failed = batch.run();
+    CHECK(failed == 0);
+
+    std::vector<fs::path> files = filesIn(output);
+    std::sort(files.begin(), files.end());
+    CHECK(files.size() == inputs);
+
+    std::vector<cv::Mat> images;
+    for (const fs::path& file : files) {
+        cv::Mat image = cv::imread(file.string(), cv::IMREAD_UNCHANGED);
+        CHECK(!image.empty());
+        images.push_back(image);
+    }
+    return images;
+}
+
+void testBatch() {
+    TempDir dir;
+    const fs::path input = dir.path / "in";
+    fs::create_directories(input);
+    const size_t inputs = 3;
+    for (size_t i = 0; i < inputs; ++i) {
+        const fs::path file = input / ("image" + std::to_string(i) + ".png");
+        CHECK(cv::imwrite(file.string(), syntheticImage(160 + 16 * static_cast<int>(i), 120, static_cast<int>(i))));
+    }
+    const std::string cacheDir = (dir.path / "cache").string();
+
+    for (int mode = 0; mode < 6; ++mode) {
+        const std::string name = "mode" + std::to_string(mode);
+        const std::vector<cv::Mat> uncached = runBatch(input, dir.path / (name + "-plain"), mode, "", inputs);
+
+        // The first cached run may extend entries written for earlier modes;
+        // the second is served from the cache. Both must match the uncached run.
+        const std::vector<cv::Mat> filled = runBatch(input, dir.path / (name + "-fill"), mode, cacheDir, inputs);
+        const std::vector<cv::Mat> hit = runBatch(input, dir.path / (name + "-hit"), mode, cacheDir, inputs);
+        CHECK(filled.size() == uncached.size() && hit.size() == uncached.size());
+        for (size_t i = 0; i < uncached.size() && i < filled.size() && i < hit.size(); ++i) {
+            CHECK(samePixels(uncached[i], filled[i]));
+            CHECK(samePixels(uncached[i], hit[i]));
+        }
+    }
+}
+
+// Entry files in a cache directory
+std::vector<fs::path> cacheEntries(const fs::path& dir) {
+    std::vector<fs::path> entries;
+    for (const fs::path& file : filesIn(dir)) {
+        if (file.extension() == ".nbc") {
+            entries.push_back(file);
+        }
+    }
+    return entries;
+}
+
+void setAge(const fs::path& file, std::chrono::minutes age) {
+    fs::last_write_time(file, fs::file_time_type::clock::now() - age);
+}
+
+void testResultCache() {
+    TempDir dir;
+
+    ImageProcessor processor;
+    processor.setImage(syntheticImage(200, 150, 1));
+    processor.processStages(ImageProcessor::STAGE_ALL);
+    const ProcessingResult& result = processor.getResult();
+    CHECK(result.stages == ImageProcessor::STAGE_ALL);
+
+    ImageProcessor::Params params;
+    const ResultCache::Key key = ResultCache::makeKey(1, params);
+    params.seed = 1;
+    CHECK(ResultCache::makeKey(1, params).params != key.params);
+
+    // Round trip
+    {
+        ResultCache cache((dir.path / "roundtrip").string(), 1ull << 30);
+        CHECK(cache.isOpen());
+        ProcessingResult loaded;
+        CHECK(!cache.load(key, loaded));
+
+        cache.store(key, result);
+        CHECK(cache.load(key, loaded));
+        CHECK(loaded.stages == result.stages);
+        CHECK(samePixels(loaded.originalImage, result.originalImage));
+        CHECK(samePixels(loaded.edgeImage, result.edgeImage));
+        CHECK(samePixels(loaded.brushStrokeImage, result.brushStrokeImage));
+        CHECK(samePixels(loaded.neonImage, result.neonImage));
+        CHECK(sameContours(loaded.contours, result.contours));
+
+        // A result with only some stages keeps only those
+        ImageProcessor partial;
+        partial.setImage(syntheticImage(200, 150, 2));
+        partial.processStages(ImageProcessor::STAGE_EDGES);
+        const ResultCache::Key partialKey = ResultCache::makeKey(2, ImageProcessor::Params());
+        cache.store(partialKey, partial.getResult());
+        ProcessingResult partialLoaded;
+        CHECK(cache.load(partialKey, partialLoaded));
+        CHECK(partialLoaded.stages == partial.getResult().stages);
+        CHECK(samePixels(partialLoaded.edgeImage, partial.getResult().edgeImage));
+        CHECK(partialLoaded.brushStrokeImage.empty());
+    }
+
+    // A damaged entry is a miss and is deleted
+    {
+        const fs::path cacheDir = dir.path / "damaged";
+        ResultCache cache(cacheDir.string(), 1ull << 30);
+        cache.store(key, result);
+        const std::vector<fs::path> entries = cacheEntries(cacheDir);
+        CHECK(entries.size() == 1);
+        if (entries.size() == 1) {
+            const uintmax_t size = fs::file_size(entries[0]);
+            std::fstream file(entries[0], std::ios::in | std::ios::out | std::ios::binary);
+            file.seekg(static_cast<std::streamoff>(size - 1));
+            const char last = static_cast<char>(file.get());
+            file.seekp(static_cast<std::streamoff>(size - 1));
+            file.put(static_cast<char>(last ^ 0x5a));
+            file.close();
+
+            ProcessingResult loaded;
+            CHECK(!cache.load(key, loaded));
+            CHECK(cacheEntries(cacheDir).empty());
+        }
+    }
+
+    // Eviction removes the least recently used entries, and a hit is a use
+    {
+        uintmax_t entrySize = 0;
+        {
+            const fs::path sizing = dir.path / "sizing";
+            ResultCache cache(sizing.string(), 1ull << 30);
+            cache.store(key, result);
+            const std::vector<fs::path> entries = cacheEntries(sizing);
+            CHECK(entries.size() == 1);
+            entrySize = entries.empty() ? 0 : fs::file_size(entries[0]);
+        }
+        CHECK(entrySize > 0);
+
+        // Room for two entries; a third pushes the total over the limit and
+        // eviction goes down to 3/4 of it (2.1 entries), i.e. back to two
+        const fs::path cacheDir = dir.path / "evict";
+        ResultCache cache(cacheDir.string(), entrySize * 14 / 5);
+        const ResultCache::Key a = ResultCache::makeKey(10, ImageProcessor::Params());
+        const ResultCache::Key b = ResultCache::makeKey(11, ImageProcessor::Params());
+        const ResultCache::Key c = ResultCache::makeKey(12, ImageProcessor::Params());
+        cache.store(a, result);
+        cache.store(b, result);
+        CHECK(cacheEntries(cacheDir).size() == 2);
+
+        // Age both, then use a: b becomes the least recently used
+        for (const fs::path& entry : cacheEntries(cacheDir)) {
+            setAge(entry, std::chrono::minutes(60));
+        }
+        ProcessingResult loaded;
+        CHECK(cache.load(a, loaded));
+
+        cache.store(c, result);
+        CHECK(cacheEntries(cacheDir).size() == 2);
+        CHECK(cache.load(a, loaded));
+        CHECK(!cache.load(b, loaded));
+        CHECK(cache.load(c, loaded));
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string group = argc > 1 ? argv[1] : "";
+    if (group == "batch" || group.empty()) {
+        testBatch();
+    }
+    if (group == "result_cache" || group.empty()) {
+        testResultCache();
+    }
+    if (failures > 0) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}